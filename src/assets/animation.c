@@ -3,6 +3,7 @@
 #include "asset.h"
 #include "core/timer.h"
 #include <math.h>
+#include <float.h>
 
 #define TOP_OFFSET_ALLIGN 72
 
@@ -215,9 +216,37 @@ void anm_update(animation_t *animation)
     }
 }
 
-void anm_render(animation_t *animation, float normalized_velocity)
+// Desenha o sprite da arma com vizinho mais próximo; na resolução máxima (scale 1) é pixel a pixel.
+// Com a resolução dinâmica a arma encolhe junto com o frame e ocupa o mesmo espaço na tela
+static void anm_draw_image(const image_t *image, const pixel_t *colormap, float offset_x, float offset_y, float scale)
 {
-    double time = t_get_time();
+    const uint8_t *mask = i_get_mask(image);
+    float inv_scale = 1.f / scale;
+    int32_t x0 = -offset_x * scale, x1 = (image->width - offset_x) * scale;
+    int32_t y0 = -offset_y * scale, y1 = (image->height - offset_y) * scale;
+    for (int32_t x = x0; x < x1; x++)
+    {
+        int32_t src_x = x * inv_scale + offset_x;
+        if (src_x < 0 || src_x >= image->width)
+            continue;
+        for (int32_t y = y0; y < y1; y++)
+        {
+            int32_t src_y = y * inv_scale + offset_y;
+            if (src_y >= 0 && src_y < image->height && mask[src_y * image->width + src_x])
+                r_draw_pixel(x, y, colormap[image->data[src_y * image->width + src_x]]);
+        }
+    }
+}
+
+void anm_render(const animation_t *animation, float normalized_velocity, int16_t light_level, double time)
+{
+    // A arma usa a luz do setor do jogador na escala mais próxima; o clarão do tiro é sempre aceso
+    const pixel_t *colormap = r_get_light_colormap(light_level, FLT_MAX);
+    const pixel_t *fullbright = r_get_colormap(0);
+    uint16_t max_width, max_height;
+    r_get_max_resolution(&max_width, &max_height);
+    float scale = r_get_width() / (float)max_width;
+
     float offset_x = 0, offset_y = 0;
     float bob_x = sin(time * BOB_SPEED) * BOB_RANGE * normalized_velocity;
     float bob_y = fabs(cos(time * BOB_SPEED)) * BOB_RANGE * normalized_velocity;
@@ -231,9 +260,7 @@ void anm_render(animation_t *animation, float normalized_velocity)
             image_t *effect = a_get_sprite(animation->first_sprite_idx + effect_id);
             offset_x = effect->left_offset;
             offset_y = effect->top_offset - TOP_OFFSET_ALLIGN;
-            for (uint32_t x = 0; x < effect->width; x++)
-                for(uint32_t y = 0; y < effect->height; y++)
-                    r_draw_pixel(x - offset_x, y - offset_y, effect->data[y * effect->width + x]);
+            anm_draw_image(effect, fullbright, offset_x, offset_y, scale);
         }
     }
 
@@ -241,7 +268,5 @@ void anm_render(animation_t *animation, float normalized_velocity)
     offset_x = sprite->left_offset + bob_x;
     offset_y = sprite->top_offset - TOP_OFFSET_ALLIGN - bob_y;
         
-    for (uint32_t x = 0; x < sprite->width; x++)
-        for(uint32_t y = 0; y < sprite->height; y++)
-            r_draw_pixel(x - offset_x, y - offset_y, sprite->data[y * sprite->width + x]);
+    anm_draw_image(sprite, colormap, offset_x, offset_y, scale);
 }
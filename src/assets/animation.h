@@ -28,6 +28,6 @@ typedef struct _animation
 animation_t anm_create_animation(uint16_t first_sprite_idx, uint16_t sprite_count, bool play_on_awake, gun_type_t type);
 
 void anm_update(animation_t *animation);
-void anm_render(animation_t *animation, float normalized_velocity);
+void anm_render(const animation_t *animation, float normalized_velocity, int16_t light_level, double time);
 
 #endif
\ No newline at end of file
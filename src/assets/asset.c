@@ -1,8 +1,11 @@
 #include "asset.h"
+#include "asset_cache.h"
 #include <string.h>
 #include "logger.h"
 #include <ctype.h>
 #include "core/timer.h"
+#include "core/jobs.h"
+#include <SDL2/SDL.h>
 
 // index base 553 
 
@@ -31,39 +34,421 @@
 #define EXPLODING_BAR1_IDX 437
 
 
+// Imagens residentes e não presas ficam numa lista LRU intrusiva: a mais recente na cabeça, a próxima a sair na cauda
+typedef struct _residency
+{
+    struct _residency *prev, *next;
+    image_t *image;
+    bool in_lru;
+    uint32_t pin_count; // níveis vivos (atual ou em pré-carga) que usam a imagem
+} residency_t;
+
 typedef struct _asset
 {
     wad_reader_t *wdr;
     palette_t *palette;
     int16_t palette_size;
+    const uint8_t *colormaps; // COLORMAP_COUNT tabelas índice -> índice, uma por nível de luz
+    uint8_t *derived_colormaps;
     uint32_t sprites_count, textures_count, flats_count;
     image_t *sprites, *textures, *flats;
+    char (*texture_names)[8], (*flat_names)[8];
     file_hash_t textures_hash, flats_hash;
+    asset_cache_t cache;
+
+    // Residência sob demanda (só quando residency_budget > 0)
+    size_t residency_budget, resident_bytes;
+    uint32_t evicted_count, composed_count;
+    residency_t *lru_head, *lru_tail;
+    SDL_mutex *residency_lock;
+    texture_map_t *texture_maps;
+    const char *patch_names;
+    uint32_t patch_names_count, first_flat_lump;
+    residency_t *texture_residency, *flat_residency;
 } asset_t;
 
 static asset_t asset_manager;
+static asset_load_stats_t load_stats;
+
+// Contexto compartilhado pelos jobs de decodificação. Cada job escreve só no
+// seu índice de images, então o resultado é idêntico ao carregamento em série.
+typedef struct _decode_job
+{
+    image_t *images;
+    uint32_t first_lump;
+    const char *patch_names;
+    const texture_map_t *texture_maps;
+    const image_t *patchs;
+} decode_job_t;
+
+static void a_decode_patch_lump(const char *name, image_t *image)
+{
+    uint32_t index;
+    if (fh_get_value(&asset_manager.wdr->file_hash, name, &index))
+        *image = i_create_image(asset_manager.wdr, index);
+    else
+        *image = (image_t){ .data = NULL };
+
+    if (image->data == NULL)
+    {
+        DOOM_LOG_DEBUG("Nao foi possivel carregar a imagem %.8s", name);
+    }
+}
+
+static void a_decode_sprite_job(void *ctx, uint32_t index)
+{
+    decode_job_t *job = (decode_job_t*)ctx;
+    a_decode_patch_lump(asset_manager.wdr->directories[job->first_lump + index].name, &job->images[index]);
+}
+
+static void a_decode_pname(const char *patch_names, uint32_t index, image_t *image)
+{
+    char name[8];
+    memset(name, 0, sizeof(name));
+    strncpy(name, patch_names + index * 8, 8);
+    for (uint8_t i = 0; i < 8; i++)
+        name[i] = toupper(name[i]);
+
+    a_decode_patch_lump(name, image);
+}
+
+static void a_decode_patch_job(void *ctx, uint32_t index)
+{
+    decode_job_t *job = (decode_job_t*)ctx;
+    a_decode_pname(job->patch_names, index, &job->images[index]);
+}
+
+static void a_compose_texture_job(void *ctx, uint32_t index)
+{
+    decode_job_t *job = (decode_job_t*)ctx;
+    job->images[index] = i_create_texture(&job->texture_maps[index], job->patchs);
+}
+
+static void a_convert_flat_job(void *ctx, uint32_t index)
+{
+    decode_job_t *job = (decode_job_t*)ctx;
+    lump_view_t view = wdr_get_lump_view(asset_manager.wdr, job->first_lump + index, 0);
+
+    if (view.data != NULL && view.size >= 4096)
+        job->images[index] = i_create_flat((const uint8_t*)view.data);
+    else
+        job->images[index] = (image_t){ .data = NULL };
+}
+
+static void a_load_patch_names(const char *patch_lump_name)
+{
+    uint32_t patch_index;
+    if (fh_get_value(&asset_manager.wdr->file_hash, patch_lump_name, &patch_index))
+    {
+        lump_view_t view = wdr_get_lump_view(asset_manager.wdr, patch_index, 4);
+        asset_manager.patch_names = (const char *)view.data;
+        asset_manager.patch_names_count = view.size / 8;
+    }
+}
+
+static uint32_t a_image_bytes(const image_t *image)
+{
+    return i_get_data_size(image);
+}
+
+// Compõe uma textura decodificando apenas os patches que ela usa
+static bool a_compose_texture(uint32_t index)
+{
+    const texture_map_t *texture_map = &asset_manager.texture_maps[index];
+    image_t *patchs = (image_t*)calloc(asset_manager.patch_names_count, sizeof(image_t));
+    if (patchs == NULL) return false;
+
+    for (uint32_t i = 0; i < texture_map->patch_count; i++)
+    {
+        uint16_t patch_index = texture_map->patch_maps[i].patch_name_index;
+        if (patch_index < asset_manager.patch_names_count && patchs[patch_index].data == NULL)
+            a_decode_pname(asset_manager.patch_names, patch_index, &patchs[patch_index]);
+    }
+
+    asset_manager.textures[index] = i_create_texture(texture_map, patchs);
+
+    for (uint32_t i = 0; i < asset_manager.patch_names_count; i++)
+        i_delete_image(&patchs[i]);
+    free(patchs);
+
+    return asset_manager.textures[index].data != NULL;
+}
+
+static bool a_compose_flat(uint32_t index)
+{
+    decode_job_t job = { .images = asset_manager.flats, .first_lump = asset_manager.first_flat_lump };
+    a_convert_flat_job(&job, index);
+    return asset_manager.flats[index].data != NULL;
+}
+
+static void a_lru_unlink(residency_t *res)
+{
+    if (!res->in_lru) return;
+
+    if (res->prev != NULL) res->prev->next = res->next;
+    else asset_manager.lru_head = res->next;
+    if (res->next != NULL) res->next->prev = res->prev;
+    else asset_manager.lru_tail = res->prev;
+
+    res->prev = res->next = NULL;
+    res->in_lru = false;
+}
+
+static void a_lru_push_front(residency_t *res, image_t *image)
+{
+    a_lru_unlink(res);
+    res->image = image;
+    res->next = asset_manager.lru_head;
+    if (asset_manager.lru_head != NULL) asset_manager.lru_head->prev = res;
+    else asset_manager.lru_tail = res;
+    asset_manager.lru_head = res;
+    res->in_lru = true;
+}
+
+static void a_lru_push_back(residency_t *res, image_t *image)
+{
+    a_lru_unlink(res);
+    res->image = image;
+    res->prev = asset_manager.lru_tail;
+    if (asset_manager.lru_tail != NULL) asset_manager.lru_tail->next = res;
+    else asset_manager.lru_head = res;
+    asset_manager.lru_tail = res;
+    res->in_lru = true;
+}
+
+// Libera a imagem residente usada há mais tempo que não está presa por nenhum nível (a cauda da LRU)
+static bool a_evict_one()
+{
+    residency_t *res = asset_manager.lru_tail;
+    if (res == NULL) return false;
+
+    a_lru_unlink(res);
+    image_t *victim = res->image;
+    asset_manager.resident_bytes -= a_image_bytes(victim);
+    i_delete_image(victim);
+    victim->data = NULL;
+    asset_manager.evicted_count++;
+    return true;
+}
 
-void a_init(wad_reader_t *wdr)
+static image_t *a_acquire(image_t *image, residency_t *res, uint32_t index, bool (*compose)(uint32_t), bool pin)
+{
+    // Modo sem orçamento: tudo já foi carregado no a_init
+    if (res == NULL) return image;
+
+    // O carregador de níveis compõe texturas em outro thread
+    SDL_LockMutex(asset_manager.residency_lock);
+
+    if (image->data == NULL)
+    {
+        if (!compose(index))
+        {
+            SDL_UnlockMutex(asset_manager.residency_lock);
+            return NULL;
+        }
+
+        asset_manager.resident_bytes += a_image_bytes(image);
+        asset_manager.composed_count++;
+
+        // A imagem recém composta só entra na LRU depois, então não pode ser a escolhida
+        while (asset_manager.resident_bytes > asset_manager.residency_budget)
+        {
+            if (!a_evict_one())
+            {
+                DOOM_LOG_WARN("Orcamento de texturas excedido pelas texturas em uso (%zu de %zu bytes)", asset_manager.resident_bytes, asset_manager.residency_budget);
+                break;
+            }
+        }
+    }
+
+    // Presa sai da LRU até o último a_unpin_image; solta vai para a cabeça
+    if (pin)
+    {
+        res->pin_count++;
+        a_lru_unlink(res);
+    }
+    else if (res->pin_count == 0)
+        a_lru_push_front(res, image);
+
+    SDL_UnlockMutex(asset_manager.residency_lock);
+    return image;
+}
+
+static bool a_create_name_hash(file_hash_t *hash, char (*names)[8], uint32_t count)
+{
+    *hash = fh_create_hash(2 * count);
+
+    // Nomes vazios não podem ser procurados e ficam de fora
+    bool created = hash->buckets != NULL;
+    for (uint32_t i = 0; i < count && created; i++)
+        if (names[i][0] != '\0')
+            created = fh_insert_hash(hash, names[i], i);
+
+    if (!created)
+        fh_delete_hash(hash);
+
+    return created;
+}
+
+static bool a_load_cache(const char *cache_path, uint64_t wad_hash)
+{
+    image_table_t tables[AC_TABLE_COUNT];
+    if (!ac_load(&asset_manager.cache, cache_path, wad_hash, tables))
+        return false;
+
+    asset_manager.sprites = tables[AC_SPRITES].images;
+    asset_manager.sprites_count = tables[AC_SPRITES].count;
+    asset_manager.textures = tables[AC_TEXTURES].images;
+    asset_manager.textures_count = tables[AC_TEXTURES].count;
+    asset_manager.texture_names = tables[AC_TEXTURES].names;
+    asset_manager.flats = tables[AC_FLATS].images;
+    asset_manager.flats_count = tables[AC_FLATS].count;
+    asset_manager.flat_names = tables[AC_FLATS].names;
+
+    // Sem os índices de nomes o cache não serve: as imagens apontam para o arquivo, então basta soltar as tabelas
+    if (!a_create_name_hash(&asset_manager.textures_hash, asset_manager.texture_names, asset_manager.textures_count) ||
+        !a_create_name_hash(&asset_manager.flats_hash, asset_manager.flat_names, asset_manager.flats_count))
+    {
+        DOOM_LOG_ERROR("Nao foi possivel indexar os nomes do cache %s", cache_path);
+        fh_delete_hash(&asset_manager.textures_hash);
+        for (uint32_t t = 0; t < AC_TABLE_COUNT; t++)
+            free(tables[t].images);
+        ac_close(&asset_manager.cache);
+
+        asset_manager.sprites = asset_manager.textures = asset_manager.flats = NULL;
+        asset_manager.sprites_count = asset_manager.textures_count = asset_manager.flats_count = 0;
+        asset_manager.texture_names = asset_manager.flat_names = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+static void a_save_cache(const char *cache_path, uint64_t wad_hash)
+{
+    image_table_t tables[AC_TABLE_COUNT] = {
+        [AC_SPRITES] = { .images = asset_manager.sprites, .names = NULL, .count = asset_manager.sprites_count },
+        [AC_TEXTURES] = { .images = asset_manager.textures, .names = asset_manager.texture_names, .count = asset_manager.textures_count },
+        [AC_FLATS] = { .images = asset_manager.flats, .names = asset_manager.flat_names, .count = asset_manager.flats_count },
+    };
+
+    // Só grava o cache quando todas as tabelas foram carregadas
+    if (asset_manager.sprites == NULL || asset_manager.textures == NULL || asset_manager.flats == NULL ||
+        asset_manager.texture_names == NULL || asset_manager.flat_names == NULL)
+        return;
+
+    ac_save(cache_path, wad_hash, tables);
+}
+
+static uint8_t a_find_nearest_color(int r, int g, int b)
+{
+    uint8_t best = 0;
+    int best_dist = INT32_MAX;
+    for (int i = 0; i < 256; i++)
+    {
+        const palette_t *color = &asset_manager.palette[i];
+        int dr = color->r - r, dg = color->g - g, db = color->b - b;
+        int dist = dr * dr + dg * dg + db * db;
+        if (dist < best_dist)
+        {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// O COLORMAP é lido direto do WAD mapeado; sem ele, escurece a paleta linearmente até o preto
+static bool a_load_colormaps()
+{
+    uint32_t index;
+    if (fh_get_value(&asset_manager.wdr->file_hash, "COLORMAP", &index))
+    {
+        lump_view_t view = wdr_get_lump_view(asset_manager.wdr, index, 0);
+        if (view.data != NULL && view.size >= COLORMAP_COUNT * 256)
+        {
+            asset_manager.colormaps = (const uint8_t*)view.data;
+            return true;
+        }
+    }
+
+    if (asset_manager.palette == NULL)
+        return false;
+
+    asset_manager.derived_colormaps = (uint8_t*)malloc(COLORMAP_COUNT * 256);
+    if (asset_manager.derived_colormaps == NULL)
+        return false;
+
+    DOOM_LOG_WARN("COLORMAP nao encontrado, usando tabelas de luz derivadas da paleta");
+    for (uint32_t map = 0; map < COLORMAP_COUNT; map++)
+    {
+        int scale = map < 32 ? 32 - map : 0;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            const palette_t *color = &asset_manager.palette[i];
+            asset_manager.derived_colormaps[map * 256 + i] = a_find_nearest_color(color->r * scale / 32, color->g * scale / 32, color->b * scale / 32);
+        }
+    }
+
+    asset_manager.colormaps = asset_manager.derived_colormaps;
+    return true;
+}
+
+void a_init(wad_reader_t *wdr, const char *cache_path)
 {
     asset_manager.wdr = wdr;
+    asset_manager.residency_lock = SDL_CreateMutex();
 
     uint32_t index;
     if (fh_get_value(&wdr->file_hash, "PLAYPAL", &index))
     {
-        uint32_t size = 0;
-        asset_manager.palette = (palette_t*)wdr_get_lump_data(wdr, index, 0, &size);
-        asset_manager.palette_size = size / sizeof(palette_t);
+        // A paleta é lida direto do WAD mapeado, sem cópia
+        lump_view_t view = wdr_get_lump_view(wdr, index, 0);
+        asset_manager.palette = (palette_t*)view.data;
+        asset_manager.palette_size = view.size / sizeof(palette_t);
+    }
+
+    if (!a_load_colormaps())
+    {
+        DOOM_LOG_ERROR("Nao foi possivel criar as tabelas de luz");
+    }
+
+    load_stats = (asset_load_stats_t){ .thread_count = j_get_thread_count() };
+    uint64_t start = t_get_counter();
+
+    // O cache é indexado pela assinatura do WAD (diretório, tamanho e data), então mudar o WAD o invalida
+    // No modo sob demanda as texturas não ficam todas residentes, então o cache não é usado
+    if (asset_manager.residency_budget > 0)
+        cache_path = NULL;
+
+    uint64_t wad_hash = 0;
+    if (cache_path != NULL)
+    {
+        wad_hash = wdr_get_fingerprint(wdr);
+        if (a_load_cache(cache_path, wad_hash))
+        {
+            load_stats.from_cache = true;
+            load_stats.total_ms = t_get_elapsed_ms(start);
+            DOOM_LOG_INFO("Assets carregados do cache %s em %.2f ms", cache_path, load_stats.total_ms);
+            return;
+        }
     }
 
     asset_manager.sprites = a_load_sprites("S_START", "S_END", &asset_manager.sprites_count);
     asset_manager.textures = a_load_textures("PNAMES", "TEXTURE1", &asset_manager.textures_count);
     asset_manager.flats = a_load_flat_textures("F1_START", "F1_END", &asset_manager.flats_count);
+    load_stats.total_ms = t_get_elapsed_ms(start);
+
+    DOOM_LOG_INFO("Assets decodificados em %.2f ms com %u threads (sprites %.2f, patches %.2f, texturas %.2f, flats %.2f)",
+        load_stats.total_ms, load_stats.thread_count, load_stats.sprites_ms, load_stats.patches_ms, load_stats.textures_ms, load_stats.flats_ms);
 
-    free(asset_manager.palette);
+    if (cache_path != NULL)
+        a_save_cache(cache_path, wad_hash);
 }
 
 image_t *a_load_sprites(const char *start_lump_name, const char *end_lump_name, uint32_t *count)
 {
+    uint64_t start = t_get_counter();
     image_t *sprites = NULL;
     uint32_t index_1, index_2;
     *count = 0;
@@ -73,70 +458,77 @@ image_t *a_load_sprites(const char *start_lump_name, const char *end_lump_name,
         sprites = (image_t*) malloc(*count * sizeof(image_t));
         if (sprites != NULL)
         {
-            for (uint32_t i = index_1 + 1, j = 0; i < index_2; i++, j++)
-            {
-                uint32_t size = 0;
-                uint16_t width, height;
-                int16_t left_offset, top_offset;
-                patch_colum_t *patch_columns = a_load_patch_columns(
-                    asset_manager.wdr->directories[i].name, &size, 
-                    &width, &height, 
-                    &left_offset, &top_offset
-                );
-                
-                if (patch_columns != NULL)
-                {
-                    sprites[j] = i_create_image(
-                        patch_columns, size, 
-                        width, height, 
-                        left_offset, top_offset
-                    );
-                    wdr_delete_patch_columns(patch_columns, size);
-                }
-                else
-                    DOOM_LOG_DEBUG("Nao foi possivel carregar a imagem %s", asset_manager.wdr->directories[i].name);
-            }
+            decode_job_t job = { .images = sprites, .first_lump = index_1 + 1 };
+            j_parallel_for(*count, a_decode_sprite_job, &job);
         }
     }
 
+    load_stats.sprites_ms = t_get_elapsed_ms(start);
     return sprites;
 }
 
 image_t *a_load_textures(const char *patch_lump_name, const char *texture_lump_name, uint32_t *count)
 {
     image_t *textures = NULL;
+    *count = 0;
+    bool lazy = asset_manager.residency_budget > 0;
 
+    // No modo sob demanda os patches só são decodificados quando uma textura é composta
     uint32_t pacths_count = 0;
-    image_t *patchs = a_load_patchs(patch_lump_name, &pacths_count);
+    image_t *patchs = NULL;
+    if (lazy)
+        a_load_patch_names(patch_lump_name);
+    else
+        patchs = a_load_patchs(patch_lump_name, &pacths_count);
+    uint64_t start = t_get_counter();
 
-    if (patchs != NULL)
+    if (patchs != NULL || (lazy && asset_manager.patch_names != NULL))
     {
         uint32_t texture_map_count = 0;
         texture_map_t *texture_maps = a_load_texture_maps("TEXTURE1", &texture_map_count);
 
         if (texture_maps != NULL)
         {
-            *count = texture_map_count;
             textures = (image_t*)malloc(texture_map_count * sizeof(image_t));
             if (textures != NULL)
             {
-                asset_manager.textures_hash = fh_create_hash(2 * texture_map_count);
+                asset_manager.texture_names = (char (*)[8])malloc(texture_map_count * 8);
+                if (asset_manager.texture_names != NULL)
+                    for (uint32_t i = 0; i < texture_map_count; i++)
+                        memcpy(asset_manager.texture_names[i], texture_maps[i].name, 8);
 
-                if (asset_manager.textures_hash.buckets != NULL)
+                if (asset_manager.texture_names != NULL && a_create_name_hash(&asset_manager.textures_hash, asset_manager.texture_names, texture_map_count))
                 {
-                    for (uint32_t i = 0; i < texture_map_count; i++)
+                    if (lazy)
                     {
-                        textures[i] = i_create_texture(&texture_maps[i], patchs);
-                        fh_insert_hash(&asset_manager.textures_hash, texture_maps[i].name, i);
+                        for (uint32_t i = 0; i < texture_map_count; i++)
+                            textures[i] = (image_t){ .width = texture_maps[i].width, .height = texture_maps[i].height, .data = NULL };
                     }
+                    else
+                    {
+                        decode_job_t job = { .images = textures, .texture_maps = texture_maps, .patchs = patchs };
+                        j_parallel_for(texture_map_count, a_compose_texture_job, &job);
+                    }
+
+                    *count = texture_map_count;
                 }
                 else
                 {
+                    free(asset_manager.texture_names);
+                    asset_manager.texture_names = NULL;
                     free(textures);
                     textures = NULL;
                 }
             }
-            wdr_delete_texture_map(texture_maps, texture_map_count);
+
+            // Os mapas continuam vivos para compor as texturas sob demanda
+            if (lazy && textures != NULL)
+            {
+                asset_manager.texture_maps = texture_maps;
+                asset_manager.texture_residency = (residency_t*)calloc(texture_map_count, sizeof(residency_t));
+            }
+            else
+                wdr_delete_texture_map(texture_maps, texture_map_count);
         }
         
         for (uint32_t i = 0; i < pacths_count; i++)
@@ -144,109 +536,95 @@ image_t *a_load_textures(const char *patch_lump_name, const char *texture_lump_n
         free(patchs);
     }
 
+    load_stats.textures_ms = t_get_elapsed_ms(start);
     return textures;
 }
 
 image_t *a_load_flat_textures(const char *start_lump_name, const char *end_lump_name, uint32_t *count)
 {
+    uint64_t start = t_get_counter();
     image_t *flat = NULL;
     uint32_t index_1, index_2;
     *count = 0;
     if (fh_get_value(&asset_manager.wdr->file_hash, start_lump_name, &index_1) && fh_get_value(&asset_manager.wdr->file_hash, end_lump_name, &index_2))
     {
-        *count = (index_2 - index_1 - 1);
-        flat = (image_t*) malloc(*count * sizeof(image_t));
-        if (flat != NULL)
+        uint32_t flat_count = (index_2 - index_1 - 1);
+        flat = (image_t*) malloc(flat_count * sizeof(image_t));
+        asset_manager.flat_names = (char (*)[8])malloc(flat_count * 8);
+        if (flat == NULL || asset_manager.flat_names == NULL)
         {
-            asset_manager.flats_hash = fh_create_hash(*count * 2);
-            if (asset_manager.flats_hash.buckets == NULL)
-            {
-                free(flat);
-                return NULL;
-            }
+            free(asset_manager.flat_names);
+            asset_manager.flat_names = NULL;
+            free(flat);
+            return NULL;
+        }
 
-            for (uint32_t i = index_1 + 1, j = 0; i < index_2; i++, j++)
-            {
-                uint8_t *data = wdr_get_lump_data(asset_manager.wdr, i, 0, NULL);
-                if (data == NULL)
-                {
-                    for (uint32_t k = 0; k < j; k++)
-                        free(flat[k].data);
-                    free(flat);
+        for (uint32_t i = index_1 + 1, j = 0; i < index_2; i++, j++)
+            memcpy(asset_manager.flat_names[j], asset_manager.wdr->directories[i].name, 8);
 
-                    fh_delete_hash(&asset_manager.flats_hash);
-                    return NULL;
-                }
-                
-                flat[j] = i_create_flat(data);
-                free(data);
-                
-                if (flat[j].data == NULL)
-                {
-                    for (uint32_t k = 0; k < j; k++)
-                        free(flat[k].data);
-                    free(flat);
+        bool lazy = asset_manager.residency_budget > 0;
+        bool loaded = a_create_name_hash(&asset_manager.flats_hash, asset_manager.flat_names, flat_count);
+        if (loaded && lazy)
+        {
+            asset_manager.first_flat_lump = index_1 + 1;
+            asset_manager.flat_residency = (residency_t*)calloc(flat_count, sizeof(residency_t));
+            for (uint32_t j = 0; j < flat_count; j++)
+                flat[j] = (image_t){ .width = 64, .height = 64, .data = NULL };
+        }
+        else if (loaded)
+        {
+            decode_job_t job = { .images = flat, .first_lump = index_1 + 1 };
+            j_parallel_for(flat_count, a_convert_flat_job, &job);
 
-                    fh_delete_hash(&asset_manager.flats_hash);
-                    return NULL;
-                }
+            for (uint32_t j = 0; j < flat_count && loaded; j++)
+                loaded = flat[j].data != NULL;
 
-                fh_insert_hash(&asset_manager.flats_hash, asset_manager.wdr->directories[i].name, j);
+            if (!loaded)
+            {
+                for (uint32_t k = 0; k < flat_count; k++)
+                    i_delete_image(&flat[k]);
+                fh_delete_hash(&asset_manager.flats_hash);
             }
         }
+
+        if (!loaded)
+        {
+            free(flat);
+            free(asset_manager.flat_names);
+            asset_manager.flat_names = NULL;
+            return NULL;
+        }
+
+        *count = flat_count;
     }
 
+    load_stats.flats_ms = t_get_elapsed_ms(start);
     return flat;
 }
 
 image_t *a_load_patchs(const char *patch_lump_name, uint32_t *count)
 {
+    uint64_t start = t_get_counter();
     uint32_t patch_index;
     image_t *patchs = NULL;
     if (fh_get_value(&asset_manager.wdr->file_hash, patch_lump_name, &patch_index))
     {
-        uint32_t patch_size = 0;
-        char *patch_names = (char *)wdr_get_lump_data(asset_manager.wdr, patch_index, 4, &patch_size);
-        *count = patch_size / 8;
+        lump_view_t view = wdr_get_lump_view(asset_manager.wdr, patch_index, 4);
+        const char *patch_names = (const char *)view.data;
+        *count = view.size / 8;
         if (patch_names != NULL)
         {
             patchs = (image_t *)malloc(*count * sizeof(image_t));
 
             if (patchs != NULL)
             {
-                for (uint32_t i = 0, j = 0; i < patch_size; i += 8, j++)
-                {
-                    char name[8];
-                    memset(name, 0, sizeof(name));
-                    strncpy(name, patch_names + i, 8);
-                    for (uint8_t i = 0; i < 8; i++)
-                        name[i] = toupper(name[i]);
-                    uint32_t size = 0;
-                    uint16_t width, height;
-                    int16_t left_offset, top_offset;
-                    patch_colum_t *patch_columns = a_load_patch_columns(name, &size, &width, &height, &left_offset, &top_offset);
-        
-                    if (patch_columns != NULL)
-                    {
-                        patchs[j] = i_create_image(
-                            patch_columns, size, 
-                            width, height, 
-                            left_offset, top_offset
-                        );
-                        wdr_delete_patch_columns(patch_columns, size);
-                    }
-                    else
-                    {
-                        patchs[j] = (image_t){ .data = NULL };
-                        DOOM_LOG_DEBUG("%d - Nao foi possivel carregar o patch %s", j, name);
-                    }
-                }
+                decode_job_t job = { .images = patchs, .patch_names = patch_names };
+                j_parallel_for(*count, a_decode_patch_job, &job);
             }
-
-            free(patch_names);
         }
     }
 
+    load_stats.patches_ms = t_get_elapsed_ms(start);
     return patchs;
 }
 
@@ -258,55 +636,26 @@ texture_map_t *a_load_texture_maps(const char *texture_lump_name, uint32_t *coun
     {
         texture_header_t header;
         wdr_get_lump_header(asset_manager.wdr, &header, texture_map_index, sizeof(header.texture_count));
-        *count = header.texture_count;
-        header.texture_data_offset = wdr_get_lump_data(asset_manager.wdr, texture_map_index, sizeof(header.texture_count), NULL);
+        lump_view_t view = wdr_get_lump_view(asset_manager.wdr, texture_map_index, sizeof(header.texture_count));
+        header.texture_data_offset = (uint32_t*)view.data;
 
-        if (header.texture_data_offset != NULL)
+        if (header.texture_data_offset != NULL && header.texture_count <= view.size / sizeof(uint32_t))
         {
+            *count = header.texture_count;
             texture_map = wdr_get_texture_map(asset_manager.wdr, &header, texture_map_index);
-            free(header.texture_data_offset);
         }
     }
 
     return texture_map;
 }
 
-patch_colum_t *a_load_patch_columns(const char *patch_name, uint32_t *size_out, uint16_t *width_out, uint16_t *height_out, int16_t *left_offset_out, int16_t *top_offset_out)
-{
-    uint32_t index;
-    if (fh_get_value(&asset_manager.wdr->file_hash, patch_name, &index))
-    {
-        patch_header_t header;
-        uint32_t header_len = sizeof(header) - sizeof(header.column_offset);
-        wdr_get_lump_header(asset_manager.wdr, &header, index, header_len);
-        *left_offset_out = header.left_offset;
-        *top_offset_out = header.top_ofsset;
-        *width_out = header.width;
-        *height_out = header.height;
-        header.column_offset = wdr_get_lump_data(asset_manager.wdr, index, header_len, NULL);
-        
-        if (header.column_offset != NULL)
-        {
-            uint32_t size = 0;
-            patch_colum_t *patch_columns = wdr_get_patch_columns(asset_manager.wdr, &header, index, &size);
-            
-            free(header.column_offset);
-            *size_out = size;
-            return patch_columns;
-        }
-    }
-
-    return NULL;
-}
-
 image_t *a_get_sprite(uint32_t index)
 {
     return &asset_manager.sprites[index];
 }
 
-image_t *a_get_sprite_by_type(int16_t type)
+image_t *a_get_sprite_by_type(int16_t type, uint64_t animation_ticks)
 {
-    uint64_t animation_ticks = t_get_animation_tick();
     switch (type)
     {
     case SHOTGUN_ENTITY_TYPE:
@@ -338,44 +687,167 @@ image_t *a_get_sprite_by_type(int16_t type)
     return NULL;
 }
 
-image_t *a_get_texture_by_name(const char *name)
+static image_t *a_get_texture(const char *name, bool pin)
 {
     uint32_t index = 0;
     if (fh_get_value(&asset_manager.textures_hash, name, &index))
-        return &asset_manager.textures[index];
+    {
+        residency_t *res = asset_manager.texture_residency ? &asset_manager.texture_residency[index] : NULL;
+        return a_acquire(&asset_manager.textures[index], res, index, a_compose_texture, pin);
+    }
     
     return NULL;
 }
 
-image_t *a_get_flat_by_name(const char *name)
+static image_t *a_get_flat(const char *name, bool pin)
 {
     uint32_t index = 0;
     if (fh_get_value(&asset_manager.flats_hash, name, &index))
-        return &asset_manager.flats[index];
+    {
+        residency_t *res = asset_manager.flat_residency ? &asset_manager.flat_residency[index] : NULL;
+        return a_acquire(&asset_manager.flats[index], res, index, a_compose_flat, pin);
+    }
     
     return NULL;
 }
 
-uint32_t a_get_palette_color(uint16_t color_index)
+image_t *a_get_texture_by_name(const char *name)
 {
-    palette_t *palette = &asset_manager.palette[color_index];
-    return (0xFF << 24) | (palette->b << 16) | (palette->g << 8) | palette->r;
+    return a_get_texture(name, false);
 }
 
-void a_shutdown()
+image_t *a_get_flat_by_name(const char *name)
 {
-    fh_delete_hash(&asset_manager.textures_hash);
-    fh_delete_hash(&asset_manager.flats_hash);
+    return a_get_flat(name, false);
+}
+
+image_t *a_pin_texture_by_name(const char *name)
+{
+    return a_get_texture(name, true);
+}
+
+image_t *a_pin_flat_by_name(const char *name)
+{
+    return a_get_flat(name, true);
+}
+
+void a_unpin_image(const image_t *image)
+{
+    residency_t *res = NULL;
+    image_t *owned = NULL;
+    if (asset_manager.texture_residency != NULL && image >= asset_manager.textures && image < asset_manager.textures + asset_manager.textures_count)
+    {
+        res = &asset_manager.texture_residency[image - asset_manager.textures];
+        owned = &asset_manager.textures[image - asset_manager.textures];
+    }
+    else if (asset_manager.flat_residency != NULL && image >= asset_manager.flats && image < asset_manager.flats + asset_manager.flats_count)
+    {
+        res = &asset_manager.flat_residency[image - asset_manager.flats];
+        owned = &asset_manager.flats[image - asset_manager.flats];
+    }
+
+    if (res == NULL) return;
+
+    // Solta pelo nível que saiu, é a primeira candidata a despejo
+    SDL_LockMutex(asset_manager.residency_lock);
+    if (res->pin_count > 0 && --res->pin_count == 0 && owned->data != NULL)
+        a_lru_push_back(res, owned);
+    SDL_UnlockMutex(asset_manager.residency_lock);
+}
+
+void a_set_residency_budget(size_t bytes)
+{
+    asset_manager.residency_budget = bytes;
+}
+
+residency_stats_t a_get_residency_stats()
+{
+    // O carregador de níveis compõe e despeja em outro thread, então a foto é tirada sob o mesmo lock
+    SDL_LockMutex(asset_manager.residency_lock);
+    residency_stats_t stats = {
+        .budget_bytes = asset_manager.residency_budget,
+        .evicted_count = asset_manager.evicted_count,
+        .composed_count = asset_manager.composed_count,
+    };
 
     for (uint32_t i = 0; i < asset_manager.textures_count; i++)
-        i_delete_image(&asset_manager.textures[i]);
-    free(asset_manager.textures);
+    {
+        if (asset_manager.textures[i].data != NULL)
+        {
+            stats.resident_textures++;
+            stats.resident_bytes += a_image_bytes(&asset_manager.textures[i]);
+        }
+    }
 
     for (uint32_t i = 0; i < asset_manager.flats_count; i++)
-        i_delete_image(&asset_manager.flats[i]);
-    free(asset_manager.flats);
+    {
+        if (asset_manager.flats[i].data != NULL)
+        {
+            stats.resident_flats++;
+            stats.resident_bytes += a_image_bytes(&asset_manager.flats[i]);
+        }
+    }
+    SDL_UnlockMutex(asset_manager.residency_lock);
 
-    for (uint32_t i = 0; i < asset_manager.sprites_count; i++)
-        i_delete_image(&asset_manager.sprites[i]);
-    free(asset_manager.sprites);
+    return stats;
+}
+
+const asset_load_stats_t *a_get_load_stats()
+{
+    return &load_stats;
+}
+
+uint32_t a_get_palette_color(uint16_t color_index)
+{
+    palette_t *palette = &asset_manager.palette[color_index];
+    return (0xFFu << 24) | (palette->b << 16) | (palette->g << 8) | palette->r;
 }
+
+const palette_t *a_get_palette(uint8_t index)
+{
+    uint32_t palette_count = asset_manager.palette_size / 256;
+    return asset_manager.palette + (index < palette_count ? index : 0) * 256;
+}
+
+const uint8_t *a_get_colormaps()
+{
+    return asset_manager.colormaps;
+}
+
+static void a_delete_images(image_t *images, uint32_t count)
+{
+    // Imagens vindas do cache apontam para o arquivo mapeado e não são liberadas uma a uma
+    for (uint32_t i = 0; i < count; i++)
+        if (!ac_owns(&asset_manager.cache, images[i].data))
+            i_delete_image(&images[i]);
+    free(images);
+}
+
+void a_shutdown()
+{
+    fh_delete_hash(&asset_manager.textures_hash);
+    fh_delete_hash(&asset_manager.flats_hash);
+
+    a_delete_images(asset_manager.textures, asset_manager.textures_count);
+    a_delete_images(asset_manager.flats, asset_manager.flats_count);
+    a_delete_images(asset_manager.sprites, asset_manager.sprites_count);
+
+    if (!ac_owns(&asset_manager.cache, asset_manager.texture_names))
+        free(asset_manager.texture_names);
+    if (!ac_owns(&asset_manager.cache, asset_manager.flat_names))
+        free(asset_manager.flat_names);
+
+    ac_close(&asset_manager.cache);
+
+    if (asset_manager.texture_maps != NULL)
+        wdr_delete_texture_map(asset_manager.texture_maps, asset_manager.textures_count);
+    free(asset_manager.texture_residency);
+    free(asset_manager.flat_residency);
+    free(asset_manager.derived_colormaps);
+    if (asset_manager.residency_lock != NULL)
+        SDL_DestroyMutex(asset_manager.residency_lock);
+
+    size_t budget = asset_manager.residency_budget;
+    asset_manager = (asset_t){0};
+    asset_manager.residency_budget = budget;
+}
\ No newline at end of file
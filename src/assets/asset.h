@@ -5,22 +5,49 @@
 #include "wad/wad_reader.h"
 #include "image.h"
 
-
-void a_init(wad_reader_t *wdr);
+// 32 níveis de luz do COLORMAP (0 é o mais claro), mais a invulnerabilidade e o preto
+#define COLORMAP_COUNT 34
+
+// Tempos (ms) de cada fase do último a_init
+typedef struct _asset_load_stats
+{
+    double sprites_ms, patches_ms, textures_ms, flats_ms, total_ms;
+    uint32_t thread_count;
+    bool from_cache;
+} asset_load_stats_t;
+
+// Estado da residência de texturas e flats
+typedef struct _residency_stats
+{
+    uint32_t resident_textures, resident_flats, evicted_count, composed_count;
+    size_t resident_bytes, budget_bytes;
+} residency_stats_t;
+
+void a_init(wad_reader_t *wdr, const char *cache_path);
 
 image_t *a_load_sprites(const char *start_lump_name, const char *end_lump_name, uint32_t *count);
 image_t *a_load_textures(const char *patch_lump_name, const char *texture_lump_name, uint32_t *count);
 image_t *a_load_flat_textures(const char *start_lump_name, const char *end_lump_name, uint32_t *count);
 image_t *a_load_patchs(const char *patch_lump_name, uint32_t *count);
 texture_map_t *a_load_texture_maps(const char *texture_lump_name, uint32_t *count);
-patch_colum_t *a_load_patch_columns(const char *patch_name, uint32_t *size_out, uint16_t *width_out, uint16_t *height_out, int16_t *left_offset_out, int16_t *top_offset_out);
 
 image_t *a_get_sprite(uint32_t index);
-image_t *a_get_sprite_by_type(int16_t type);
+image_t *a_get_sprite_by_type(int16_t type, uint64_t animation_tick);
 image_t *a_get_texture_by_name(const char *name);
 image_t *a_get_flat_by_name(const char *name);
 
+// Com orçamento > 0 (definido antes do a_init), texturas e flats são compostos
+// na primeira referência e os que nenhum nível prendeu são despejados por LRU
+void a_set_residency_budget(size_t bytes);
+image_t *a_pin_texture_by_name(const char *name);
+image_t *a_pin_flat_by_name(const char *name);
+void a_unpin_image(const image_t *image);
+residency_stats_t a_get_residency_stats();
+
 uint32_t a_get_palette_color(uint16_t color_index);
+const palette_t *a_get_palette(uint8_t index); // Uma das paletas do PLAYPAL (dano, itens, radiação)
+const uint8_t *a_get_colormaps(); // COLORMAP_COUNT tabelas de 256 índices
+const asset_load_stats_t *a_get_load_stats();
 
 
 void a_shutdown();
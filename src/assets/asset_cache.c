@@ -0,0 +1,239 @@
+#include "asset_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include "logger.h"
+
+#define AC_MAGIC "DOOMACHE"
+#define AC_VERSION 3
+#define AC_PAGE_SIZE 4096
+#define AC_PIXEL_ALIGN 64
+#define AC_IMAGE_MASKED 0x1 // pixels seguidos da máscara de opacidade
+
+#define AC_ALIGN(_v, _a) (((_v) + ((_a) - 1)) & ~((uint64_t)(_a) - 1))
+
+//
+// Layout do arquivo:
+//  [cache_header_t][cache_image_t * total][nomes 8 bytes]...[pixels alinhados à página]
+// As imagens das três tabelas ficam em sequência (sprites, texturas, flats),
+// assim como os nomes das tabelas que possuem nome.
+//
+typedef struct _cache_header
+{
+    char magic[8];
+    uint32_t version, page_size;
+    uint64_t wad_hash, file_size;
+    uint32_t counts[AC_TABLE_COUNT];
+    uint32_t has_names[AC_TABLE_COUNT];
+    uint64_t images_offset, names_offset, pixels_offset;
+} cache_header_t;
+
+typedef struct _cache_image
+{
+    uint16_t width, height;
+    int16_t left_offset, top_offset;
+    uint32_t flags;
+    uint64_t data_offset; // 0 quando a imagem não possui pixels
+} cache_image_t;
+
+static uint64_t ac_image_bytes(const cache_image_t *cached)
+{
+    uint64_t pixels = (uint64_t)cached->width * cached->height;
+    return (cached->flags & AC_IMAGE_MASKED) ? pixels * 2 : pixels;
+}
+
+static bool ac_write_padding(FILE *file, uint64_t from, uint64_t to)
+{
+    static const uint8_t zeros[AC_PAGE_SIZE] = {0};
+    while (from < to)
+    {
+        uint64_t len = (to - from) > sizeof(zeros) ? sizeof(zeros) : (to - from);
+        if (fwrite(zeros, len, 1, file) != 1) return false;
+        from += len;
+    }
+    return true;
+}
+
+bool ac_load(asset_cache_t *cache, const char *path, uint64_t wad_hash, image_table_t tables[AC_TABLE_COUNT])
+{
+    memset(tables, 0, sizeof(image_table_t) * AC_TABLE_COUNT);
+    cache->file = fm_open(path);
+
+    const uint8_t *base = cache->file.data;
+    uint64_t size = cache->file.size;
+    if (base == NULL || size < sizeof(cache_header_t))
+    {
+        ac_close(cache);
+        return false;
+    }
+
+    cache_header_t header;
+    memcpy(&header, base, sizeof(header));
+
+    if (memcmp(header.magic, AC_MAGIC, sizeof(header.magic)) != 0 || header.version != AC_VERSION ||
+        header.wad_hash != wad_hash || header.file_size != size)
+    {
+        DOOM_LOG_INFO("Cache de assets %s invalido ou desatualizado", path);
+        ac_close(cache);
+        return false;
+    }
+
+    uint64_t total_images = 0, total_names = 0;
+    for (uint32_t t = 0; t < AC_TABLE_COUNT; t++)
+    {
+        total_images += header.counts[t];
+        if (header.has_names[t])
+            total_names += header.counts[t];
+    }
+
+    if (header.images_offset + total_images * sizeof(cache_image_t) > size || header.names_offset + total_names * 8 > size)
+    {
+        ac_close(cache);
+        return false;
+    }
+
+    const cache_image_t *cached = (const cache_image_t*)(base + header.images_offset);
+    char (*names)[8] = (char (*)[8])(base + header.names_offset);
+
+    for (uint32_t t = 0; t < AC_TABLE_COUNT; t++)
+    {
+        image_table_t *table = &tables[t];
+        table->count = header.counts[t];
+        table->images = (image_t*)malloc(table->count * sizeof(image_t));
+
+        if (table->images == NULL && table->count > 0)
+        {
+            for (uint32_t k = 0; k < t; k++)
+                free(tables[k].images);
+            memset(tables, 0, sizeof(image_table_t) * AC_TABLE_COUNT);
+            ac_close(cache);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < table->count; i++, cached++)
+        {
+            image_t *image = &table->images[i];
+            image->width = cached->width;
+            image->height = cached->height;
+            image->left_offset = cached->left_offset;
+            image->top_offset = cached->top_offset;
+            image->masked = (cached->flags & AC_IMAGE_MASKED) != 0;
+            image->data = NULL;
+
+            if (cached->data_offset != 0 && cached->data_offset + ac_image_bytes(cached) <= size)
+                image->data = (uint8_t*)(base + cached->data_offset);
+        }
+
+        if (header.has_names[t])
+        {
+            table->names = names;
+            names += table->count;
+        }
+    }
+
+    return true;
+}
+
+bool ac_save(const char *path, uint64_t wad_hash, const image_table_t tables[AC_TABLE_COUNT])
+{
+    cache_header_t header = {0};
+    memcpy(header.magic, AC_MAGIC, sizeof(header.magic));
+    header.version = AC_VERSION;
+    header.page_size = AC_PAGE_SIZE;
+    header.wad_hash = wad_hash;
+
+    uint64_t total_images = 0, total_names = 0;
+    for (uint32_t t = 0; t < AC_TABLE_COUNT; t++)
+    {
+        header.counts[t] = tables[t].count;
+        header.has_names[t] = tables[t].names != NULL;
+        total_images += tables[t].count;
+        if (tables[t].names != NULL)
+            total_names += tables[t].count;
+    }
+
+    header.images_offset = AC_ALIGN(sizeof(cache_header_t), 16);
+    header.names_offset = header.images_offset + total_images * sizeof(cache_image_t);
+    header.pixels_offset = AC_ALIGN(header.names_offset + total_names * 8, AC_PAGE_SIZE);
+
+    cache_image_t *cached = (cache_image_t*)calloc(total_images > 0 ? total_images : 1, sizeof(cache_image_t));
+    if (cached == NULL) return false;
+
+    uint64_t offset = header.pixels_offset;
+    for (uint32_t t = 0, k = 0; t < AC_TABLE_COUNT; t++)
+    {
+        for (uint32_t i = 0; i < tables[t].count; i++, k++)
+        {
+            const image_t *image = &tables[t].images[i];
+            cached[k].width = image->width;
+            cached[k].height = image->height;
+            cached[k].left_offset = image->left_offset;
+            cached[k].top_offset = image->top_offset;
+            cached[k].flags = image->masked ? AC_IMAGE_MASKED : 0;
+
+            if (image->data != NULL)
+            {
+                cached[k].data_offset = offset;
+                offset = AC_ALIGN(offset + ac_image_bytes(&cached[k]), AC_PIXEL_ALIGN);
+            }
+        }
+    }
+    header.file_size = AC_ALIGN(offset, AC_PAGE_SIZE);
+
+    // Escreve em um arquivo temporário e renomeia, para que outra instância
+    // nunca mapeie um cache pela metade
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+    {
+        free(cached);
+        DOOM_LOG_WARN("Nao foi possivel criar o cache de assets %s", path);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && ac_write_padding(file, sizeof(header), header.images_offset);
+    ok = ok && (total_images == 0 || fwrite(cached, sizeof(cache_image_t), total_images, file) == total_images);
+
+    for (uint32_t t = 0; ok && t < AC_TABLE_COUNT; t++)
+        if (tables[t].names != NULL && tables[t].count > 0)
+            ok = fwrite(tables[t].names, 8, tables[t].count, file) == tables[t].count;
+
+    uint64_t written = header.names_offset + total_names * 8;
+    for (uint32_t t = 0, k = 0; ok && t < AC_TABLE_COUNT; t++)
+    {
+        for (uint32_t i = 0; ok && i < tables[t].count; i++, k++)
+        {
+            if (cached[k].data_offset == 0) continue;
+
+            const image_t *image = &tables[t].images[i];
+            uint64_t bytes = ac_image_bytes(&cached[k]);
+            ok = ac_write_padding(file, written, cached[k].data_offset) && (bytes == 0 || fwrite(image->data, bytes, 1, file) == 1);
+            written = cached[k].data_offset + bytes;
+        }
+    }
+
+    ok = ok && ac_write_padding(file, written, header.file_size);
+    ok = (fclose(file) == 0) && ok;
+    free(cached);
+
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        remove(tmp_path);
+        DOOM_LOG_WARN("Nao foi possivel escrever o cache de assets %s", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool ac_owns(const asset_cache_t *cache, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t*)ptr;
+    return cache->file.data != NULL && p >= cache->file.data && p < cache->file.data + cache->file.size;
+}
+
+void ac_close(asset_cache_t *cache)
+{
+    fm_close(&cache->file);
+}
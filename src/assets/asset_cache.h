@@ -0,0 +1,35 @@
+#ifndef ASSET_CACHE_H_INCLUDED
+#define ASSET_CACHE_H_INCLUDED
+
+#include "typedefs.h"
+#include "image.h"
+#include "wad/file_map.h"
+
+typedef enum _cache_table
+{
+    AC_SPRITES,
+    AC_TEXTURES,
+    AC_FLATS,
+    AC_TABLE_COUNT
+} cache_table_t;
+
+typedef struct _image_table
+{
+    image_t *images;
+    char (*names)[8]; // NULL para tabelas acessadas só por índice (sprites)
+    uint32_t count;
+} image_table_t;
+
+// Cache em disco com as imagens já decodificadas. Em um acerto os pixels
+// e os nomes apontam direto para o arquivo mapeado.
+typedef struct _asset_cache
+{
+    file_map_t file;
+} asset_cache_t;
+
+bool ac_load(asset_cache_t *cache, const char *path, uint64_t wad_hash, image_table_t tables[AC_TABLE_COUNT]);
+bool ac_save(const char *path, uint64_t wad_hash, const image_table_t tables[AC_TABLE_COUNT]);
+bool ac_owns(const asset_cache_t *cache, const void *ptr);
+void ac_close(asset_cache_t *cache);
+
+#endif
@@ -2,29 +2,41 @@
 #include "asset.h"
 #include <string.h>
 
-image_t i_create_image(const patch_colum_t *columns, uint32_t columns_size, uint16_t width, uint16_t height, int16_t left_offset, int16_t top_offset)
+static void i_write_post(void *ctx, uint16_t x, uint8_t top_delta, const uint8_t *data, uint8_t length)
 {
-    image_t image;
-    image.width = width;
-    image.height = height;
-    image.left_offset = left_offset;
-    image.top_offset = top_offset;
+    image_t *image = (image_t*)ctx;
+    uint32_t y_end = top_delta + length > image->height ? image->height : top_delta + length;
+
+    uint8_t *mask = image->data + image->width * image->height;
+
+    for (uint32_t y = top_delta; y < y_end; y++)
+    {
+        image->data[y * image->width + x] = data[y - top_delta];
+        mask[y * image->width + x] = 1;
+    }
+}
+
+image_t i_create_image(const wad_reader_t *wdr, uint32_t lump_index)
+{
+    image_t image = { .data = NULL };
+    patch_header_t header;
+
+    if (!wdr_get_patch_header(wdr, &header, lump_index))
+        return image;
 
-    image.data = (uint32_t*)malloc(width * height * sizeof(uint32_t));
+    image.width = header.width;
+    image.height = header.height;
+    image.left_offset = header.left_offset;
+    image.top_offset = header.top_ofsset;
+
+    // O índice 0 é uma cor válida, então a transparência fica numa máscara depois dos pixels
+    image.masked = true;
+    image.data = (uint8_t*)calloc(i_get_data_size(&image), 1);
     
-    if (image.data != NULL)
+    if (image.data != NULL && !wdr_for_each_patch_post(wdr, &header, lump_index, i_write_post, &image))
     {
-        memset(image.data, 0, width * height * sizeof(uint32_t));
-        uint16_t x = 0;
-        for (uint32_t i = 0; i < columns_size; i++)
-        {
-            if (columns[i].top_delta != 0xFF)
-            {
-                for (uint16_t y = 0; y < columns[i].length; y++)
-                    image.data[(y + columns[i].top_delta) * width + x] = a_get_palette_color(columns[i].data[y]);
-            }
-            else { x++; }
-        }
+        free(image.data);
+        image.data = NULL;
     }
 
     return image;
@@ -37,12 +49,13 @@ image_t i_create_texture(const texture_map_t *texture_map, const image_t *patche
     image.height = texture_map->height;
     image.left_offset = 0;
     image.top_offset = 0;
+    image.masked = false;
     
-    image.data = (uint32_t*)malloc(image.width * image.height * sizeof(uint32_t));
+    image.data = (uint8_t*)malloc(i_get_data_size(&image));
 
     if (image.data != NULL)
     {
-        memset(image.data, 0, image.width * image.height * sizeof(uint32_t));
+        memset(image.data, 0, i_get_data_size(&image));
         for (uint32_t i = 0; i < texture_map->patch_count; i++)
         {
             patch_map_t *patch_map = &texture_map->patch_maps[i];
@@ -56,8 +69,11 @@ image_t i_create_texture(const texture_map_t *texture_map, const image_t *patche
                 uint16_t y_start = patch_map->y_offset < 0 ? 0 : patch_map->y_offset;
                 uint16_t y_end = (patch_map->y_offset + patch->height) > image.height ? image.height : (patch_map->y_offset + patch->height);
                 for (uint16_t x = x_start; x < x_end; x++)
+                {
+                    uint8_t *column = image.data + x * image.height;
                     for (uint16_t y = y_start; y < y_end; y++)
-                        image.data[y * image.width + x] = patch->data[(y - patch_map->y_offset) * patch->width + (x - patch_map->x_offset)];
+                        column[y] = patch->data[(y - patch_map->y_offset) * patch->width + (x - patch_map->x_offset)];
+                }
             }
         }
     }
@@ -65,23 +81,38 @@ image_t i_create_texture(const texture_map_t *texture_map, const image_t *patche
     return image;
 }
 
-image_t i_create_flat(uint8_t *data)
+image_t i_create_flat(const uint8_t *data)
 {
     image_t image;
     image.width = 64;
     image.height = 64;
     image.left_offset = 0;
     image.top_offset = 0;
+    image.masked = false;
 
-    image.data = (uint32_t*)malloc(4096 * sizeof(uint32_t));
+    image.data = (uint8_t*)malloc(4096);
     if (image.data != NULL)
-    {
-        for (uint32_t i = 0; i < 4096; i++)
-            image.data[i] = a_get_palette_color(data[i]);
-    }
+        memcpy(image.data, data, 4096);
+
     return image;
 }
 
+size_t i_get_data_size(const image_t *image)
+{
+    size_t pixels = (size_t)image->width * image->height;
+    return image->masked ? pixels * 2 : pixels;
+}
+
+const uint8_t *i_get_mask(const image_t *image)
+{
+    return image->masked && image->data != NULL ? image->data + image->width * image->height : NULL;
+}
+
+const uint8_t *i_get_column(const image_t *texture, uint16_t x)
+{
+    return texture->data + (size_t)x * texture->height;
+}
+
 void i_delete_image(image_t *image)
 {
     if (image->data)
@@ -2,17 +2,25 @@
 #define IMAGE_H_INCLUDED
 
 #include "typedefs.h"
+#include "wad/wad_reader.h"
 
 typedef struct _image
 {
     uint16_t width, height;
     int16_t left_offset, top_offset;
-    uint32_t *data;
+    bool masked;
+    uint8_t *data; // Índices na paleta; com máscara, seguidos de width * height bytes de opacidade
 } image_t;
 
-image_t i_create_image(const patch_colum_t *columns, uint32_t columns_size, uint16_t width, uint16_t height, int16_t left_offset, int16_t top_offset);
+// Texturas de parede (i_create_texture) ficam por coluna, data[x * height + y], porque são desenhadas
+// de cima para baixo; patches, sprites e flats continuam por linha
+
+image_t i_create_image(const wad_reader_t *wdr, uint32_t lump_index);
 image_t i_create_texture(const texture_map_t *texture_map, const image_t *patches);
-image_t i_create_flat(uint8_t *data);
+image_t i_create_flat(const uint8_t *data);
+size_t i_get_data_size(const image_t *image);
+const uint8_t *i_get_mask(const image_t *image);
+const uint8_t *i_get_column(const image_t *texture, uint16_t x);
 void i_delete_image(image_t *image);
 
 #endif
\ No newline at end of file
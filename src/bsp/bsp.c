@@ -3,11 +3,16 @@
 #include <math.h>
 #include "utils.h"
 #include <string.h>
+#include <stdlib.h>
 #include "logger.h"
 #include "assets/asset.h"
+#include "core/jobs.h"
 
 #define SUB_SECTOR_IDENTIFIER 0x8000
 
+// Coisas mais perto que isso do plano da câmera não são desenhadas
+#define MIN_SPRITE_Z 4.f
+
 #define LINE_TWO_SIDED 0x04
 #define LINE_DONT_PEG_TOP 0x08
 #define LINE_DONT_PEG_BOTTOM 0x10
@@ -33,32 +38,114 @@ static uint8_t check_coord[12][4] =
     {2,1,3,0}
 };
 
-static int16_t camera_x, camera_y, camera_z;
-static float camera_angle;
+// Intervalo de colunas [first, last] já coberto por paredes sólidas
+typedef struct _cliprange
+{
+    int16_t first, last;
+} cliprange_t;
+
+// Setores cujos subsetores a travessia de uma faixa visitou, na ordem da primeira visita
+typedef struct _bsp_sector_visit
+{
+    int16_t *sectors;
+    uint8_t *seen;
+    uint32_t count;
+} bsp_sector_visit_t;
+
+// Estado de uma travessia da BSP para uma faixa da tela. Os segmentos sólidos começam com tudo fora
+// da faixa coberto, então caixas e segs das outras faixas são descartados pelo mesmo teste de oclusão
+typedef struct _bsp_view
+{
+    bsp_t *bsp;
+    const bsp_camera_t *camera;
+    render_strip_t *strip;
+    cliprange_t *solid_segs;
+    uint16_t solid_segs_count;
+    int16_t seg_x1, seg_x2; // Colunas do seg atual antes do recorte
+    bsp_sector_visit_t *visit;
+    bool running_traverse;
+} bsp_view_t;
+
+// Sprite visível no frame, resolvido antes do desenho paralelo
+typedef struct _bsp_sprite
+{
+    const image_t *image;
+    int16_t z, light_level;
+    float x, rw_scale;
+    vertex_t position;
+} bsp_sprite_t;
+
+typedef struct _bsp_sprite_list
+{
+    bsp_sprite_t *sprites;
+    uint16_t count;
+} bsp_sprite_list_t;
 
-static bool bsp_point_on_side(node_t *node)
+static bool bsp_point_on_side(const bsp_camera_t *camera, node_t *node)
 {
-    int16_t dx = camera_x - node->x_partition;
-    int16_t dy = camera_y - node->y_partition;
+    int16_t dx = camera->x - node->x_partition;
+    int16_t dy = camera->y - node->y_partition;
     return (dx * node->dy_partition - dy * node->dx_partition) <= 0;
 }
 
-static bool bsp_check_box(bbox_t *bbox)
+static int16_t bsp_get_subsector_sector_id(bsp_t *bsp, const subsector_t *subsector)
+{
+    seg_t *seg = &bsp->segs[subsector->first_seg_id];
+
+    int16_t front_sidedef = seg->direction ? bsp->linedefs[seg->linedef_id].back_sidedef_id 
+                                                            : 
+                                            bsp->linedefs[seg->linedef_id].front_sidedef_id;
+
+    return bsp->sidedefs[front_sidedef].sector_id;
+}
+
+static int16_t bsp_get_sector_id_at(bsp_t *bsp, int16_t x, int16_t y)
 {
+    int16_t sub_sector_id = bsp->root_id;
+
+    while((sub_sector_id & SUB_SECTOR_IDENTIFIER) == 0)
+    {
+        node_t *node = &bsp->nodes[sub_sector_id];
+        int16_t dx = x - node->x_partition;
+        int16_t dy = y - node->y_partition;
+        sub_sector_id = (dx * node->dy_partition - dy * node->dx_partition) <= 0 ? node->left_child : node->right_child;
+    }
+
+    sub_sector_id = (sub_sector_id == -1) ? 0 : sub_sector_id & (~SUB_SECTOR_IDENTIFIER);
+    return bsp_get_subsector_sector_id(bsp, &bsp->subsectors[sub_sector_id]);
+}
+
+static sector_t *bsp_get_sector_at(bsp_t *bsp, int16_t x, int16_t y)
+{
+    return &bsp->sectors[bsp_get_sector_id_at(bsp, x, y)];
+}
+
+static bool bsp_is_range_occluded(const bsp_view_t *view, int16_t first, int16_t last)
+{
+    const cliprange_t *range = view->solid_segs;
+    while (range->last < last)
+        range++;
+
+    return range->first <= first;
+}
+
+static bool bsp_check_box(const bsp_view_t *view, bbox_t *bbox)
+{
+    const bsp_camera_t *camera = view->camera;
     int16_t			box_x;
     int16_t			box_y;
     // Find the corners of the box
     // that define the edges from current viewpoint.
-    if (camera_x <= bbox->left)
+    if (camera->x <= bbox->left)
 	    box_x = 0;
-    else if (camera_x < bbox->right)
+    else if (camera->x < bbox->right)
 	    box_x = 1;
     else
 	    box_x = 2;
 		
-    if (camera_y >= bbox->top)
+    if (camera->y >= bbox->top)
 	    box_y = 0;
-    else if (camera_y > bbox->bottom)
+    else if (camera->y > bbox->bottom)
 	    box_y = 1;
     else
 	    box_y = 2;
@@ -72,59 +159,80 @@ static bool bsp_check_box(bbox_t *bbox)
     int16_t y2 = *((int16_t*)bbox + check_coord[box_pos][3]);
     
     // check clip list for an open space
-    int16_t dx1 = x1 - camera_x;
-    int16_t dy1 = y1 - camera_y;
-    int16_t dx2 = x2 - camera_x;
-    int16_t dy2 = y2 - camera_y;
-    float angle1 = atan2(dy1, dx1) - camera_angle;
-    float angle2 = atan2(dy2, dx2) - camera_angle;
-	
-    float span = u_normalize_angle(angle1 - angle2);
+    int16_t dx1 = x1 - camera->x;
+    int16_t dy1 = y1 - camera->y;
+    int16_t dx2 = x2 - camera->x;
+    int16_t dy2 = y2 - camera->y;
+    angle_t angle1 = u_point_to_angle(dx1, dy1) - camera->view_angle;
+    angle_t angle2 = u_point_to_angle(dx2, dy2) - camera->view_angle;
+
+    angle_t span = angle1 - angle2;
+    if (span >= ANG180) return true;
+
+    angle_t tspan1 = angle1 + ANG45;
+    if (tspan1 > ANG90)
+    {
+        if (tspan1 - ANG90 >= span) return false;
+        angle1 = ANG45;
+    }
 
-    if (span >= PI) return true;
-    
-    float tspan1 = u_normalize_angle(angle1 + H_FOV);
-    float tspan2 = u_normalize_angle(H_FOV - angle2);
-    return (tspan1 <= FOV || tspan1 < span + FOV) && (tspan2 <= FOV || tspan2 < span + FOV); 
+    angle_t tspan2 = ANG45 - angle2;
+    if (tspan2 > ANG90)
+    {
+        if (tspan2 - ANG90 >= span) return false;
+        angle2 = -ANG45;
+    }
+
+    // Colunas ocupadas pela caixa; se já estão atrás de uma parede sólida a subárvore é descartada
+    int16_t sx1 = r_view_angle_to_x(angle1);
+    int16_t sx2 = r_view_angle_to_x(angle2) - 1;
+    if (sx1 > sx2) return false;
+
+    return !bsp_is_range_occluded(view, sx1, sx2);
 }
 
-static bool bsp_add_segment_to_fov(vertex_t a, vertex_t b, int16_t *x1, int16_t *x2, float *rw_angle)
+// Ângulos em BAM: as diferenças dão a volta sozinhas, sem normalizar
+static bool bsp_add_segment_to_fov(const bsp_camera_t *camera, vertex_t a, vertex_t b, int16_t *x1, int16_t *x2, angle_t *rw_angle)
 {
-    float angle1 = atan2(a.y - camera_y, a.x - camera_x);
-    float angle2 = atan2(b.y - camera_y, b.x - camera_x);
+    angle_t angle1 = u_point_to_angle(a.x - camera->x, a.y - camera->y);
+    angle_t angle2 = u_point_to_angle(b.x - camera->x, b.y - camera->y);
 
-    float span = u_normalize_angle(angle1 - angle2);
-    if (span >= PI) return false;
+    angle_t span = angle1 - angle2;
+    if (span >= ANG180) return false;
 
     *rw_angle = angle1;
 
-    angle1 -= camera_angle;
-    angle2 -= camera_angle;
+    angle1 -= camera->view_angle;
+    angle2 -= camera->view_angle;
 
-    float tspan1 = u_normalize_angle(angle1 + H_FOV);
-    if (tspan1 > FOV)
+    angle_t tspan1 = angle1 + ANG45;
+    if (tspan1 > ANG90)
     {
-        if (tspan1 >= span + FOV)
+        if (tspan1 - ANG90 >= span)
              return false;
-        angle1 = H_FOV;
+        angle1 = ANG45;
     }
 
-    float tspan2 = u_normalize_angle(H_FOV - angle2);
-    if (tspan2 > FOV)
+    angle_t tspan2 = ANG45 - angle2;
+    if (tspan2 > ANG90)
     {
-        if (tspan2 >= span + FOV)
+        if (tspan2 - ANG90 >= span)
             return false;
-        angle2 = -H_FOV;
+        angle2 = -ANG45;
     }
 
-    *x1 = r_angle_to_x(angle1);
-    *x2 = r_angle_to_x(angle2);
+    *x1 = r_view_angle_to_x(angle1);
+    *x2 = r_view_angle_to_x(angle2);
 
     return true; 
 }
 
-static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sector_id, int16_t back_sector_id, int16_t x1, int16_t x2, float rw_angle)
+static void bsp_draw_portal_wall_range(bsp_view_t *view, seg_t *seg, int16_t front_sector_id, int16_t back_sector_id, int16_t x1, int16_t x2, angle_t rw_angle)
 {
+    if (x2 < view->strip->x_start || x1 > view->strip->x_end) return;
+
+    bsp_t *bsp = view->bsp;
+    const bsp_camera_t *camera = view->camera;
     sector_t *front_sector = &bsp->sectors[front_sector_id];
     sector_t *back_sector = &bsp->sectors[back_sector_id];
     linedef_t *line = &bsp->linedefs[seg->linedef_id];
@@ -134,17 +242,16 @@ static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sec
     else
         side = &bsp->sidedefs[line->front_sidedef_id];
 
-    char *upper_wall_texture = side->upper_texture_name;
-    char *lower_wall_texture = side->lower_texture_name;
-    char *ceil_texture = front_sector->ceil_texture_name;
-    char *floor_texture = front_sector->floor_texture_name;
+    side_textures_t *side_textures = &bsp->side_textures[side - bsp->sidedefs];
+    sector_flats_t *front_flats = &bsp->sector_flats[front_sector_id];
+    sector_flats_t *back_flats = &bsp->sector_flats[back_sector_id];
     int16_t light_level = front_sector->light_level;
 
-    int16_t world_front_z1 = front_sector->ceil_z - camera_z;
-    int16_t world_back_z1 = back_sector->ceil_z - camera_z;
+    int16_t world_front_z1 = front_sector->ceil_z - camera->z;
+    int16_t world_back_z1 = back_sector->ceil_z - camera->z;
 
-    int16_t world_front_z2 = front_sector->floor_z - camera_z;
-    int16_t world_back_z2 = back_sector->floor_z - camera_z;
+    int16_t world_front_z2 = front_sector->floor_z - camera->z;
+    int16_t world_back_z2 = back_sector->floor_z - camera->z;
 
     bool draw_wall = false;
     bool draw_ceil = false;
@@ -152,44 +259,42 @@ static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sec
     bool draw_upper_wall = false;
     bool draw_lower_wall = false;
 
-    if (strcmp(front_sector->ceil_texture_name, back_sector->ceil_texture_name) == 0 && strcmp(front_sector->ceil_texture_name, "F_SKY1") == 0)
+    if (front_flats->ceil_is_sky && back_flats->ceil_is_sky)
         world_front_z1 = world_back_z1;
 
     if (world_front_z1 != world_back_z1 || front_sector->light_level != back_sector->light_level 
-        || strcmp(ceil_texture, back_sector->ceil_texture_name) != 0)
+        || front_flats->ceil != back_flats->ceil)
     {
-        draw_upper_wall = (upper_wall_texture[0] != '-') && world_back_z1 < world_front_z1;
+        draw_upper_wall = side_textures->upper != NULL && world_back_z1 < world_front_z1;
         draw_ceil = world_front_z1 >= 0;
     }
 
     if (world_front_z2 != world_back_z2 || front_sector->light_level != back_sector->light_level
-        || strcmp(floor_texture, back_sector->floor_texture_name) != 0)
+        || front_flats->floor != back_flats->floor)
     {
-        draw_lower_wall = (lower_wall_texture[0] != '-') && world_back_z2 > world_front_z2;
+        draw_lower_wall = side_textures->lower != NULL && world_back_z2 > world_front_z2;
         draw_floor = world_front_z2 <= 0;    
     }
 
     if (!draw_upper_wall && !draw_ceil && !draw_lower_wall && !draw_floor) return;
 
-    float rw_normal_angle = u_convert_bams_to_radians(seg->angle) + PI_2;
-    float offset_angle = rw_normal_angle - rw_angle;
+    angle_t rw_normal = u_convert_bams(seg->angle) + ANG90;
+    angle_t offset_angle = rw_normal - rw_angle;
+    float rw_normal_angle = u_bam_to_radians(rw_normal);
 
     vertex_t *start_vertex = &bsp->vertexes[seg->start_vertex];
-    float dx = camera_x - start_vertex->x;
-    float dy = camera_y - start_vertex->y;
+    float dx = camera->x - start_vertex->x;
+    float dy = camera->y - start_vertex->y;
     float hypotenuse = sqrt(dx * dx + dy * dy);
-    float rw_distance = hypotenuse * cos(offset_angle);
+    float rw_distance = hypotenuse * u_fine_cosine(offset_angle);
 
     float upper_tex_alt = world_front_z1;
     if (draw_upper_wall)
     {
-        image_t *upper_texture = a_get_texture_by_name(upper_wall_texture);
-        if (upper_texture == NULL) return;
-
         if ((line->flags & LINE_DONT_PEG_TOP) == 0)
         {
-            float v_top = back_sector->ceil_z + upper_texture->height;
-            upper_tex_alt = v_top - camera_z;
+            float v_top = back_sector->ceil_z + side_textures->upper->height;
+            upper_tex_alt = v_top - camera->z;
         }
 
         upper_tex_alt += side->y_offset;
@@ -198,18 +303,15 @@ static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sec
     float lower_tex_alt = world_front_z1;
     if (draw_lower_wall)
     {
-        image_t *lower_texture = a_get_texture_by_name(lower_wall_texture);
-        if (lower_texture == NULL) return;
-
         if ((line->flags & LINE_DONT_PEG_BOTTOM) == 0)
             lower_tex_alt = world_back_z2;
 
         lower_tex_alt += side->y_offset;
     }
 
-    float rw_offset = hypotenuse * sin(offset_angle);
+    float rw_offset = hypotenuse * u_fine_sine(offset_angle);
     rw_offset += seg->offset + side->x_offset;
-    float rw_center_angle = rw_normal_angle - camera_angle;
+    float rw_center_angle = rw_normal_angle - camera->angle;
 
     portal_wall_desc_t desc = {
         .draw_upper_wall = draw_upper_wall,
@@ -218,6 +320,8 @@ static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sec
         .draw_floor = draw_floor,
         .x1 = x1,
         .x2 = x2,
+        .seg_x1 = view->seg_x1,
+        .seg_x2 = view->seg_x2,
         .light_level = light_level,
         .rw_normal_angle = rw_normal_angle,
         .rw_distance = rw_distance,
@@ -225,21 +329,29 @@ static void bsp_draw_portal_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sec
         .lower_tex_alt = lower_tex_alt,
         .rw_offset = rw_offset,
         .rw_center_angle = rw_center_angle,
+        .seg_start = *start_vertex,
+        .seg_end = bsp->vertexes[seg->end_vertex],
         .world_front_z1 = world_front_z1,
         .world_back_z1 = world_back_z1,
         .world_front_z2 = world_front_z2,
         .world_back_z2 = world_back_z2,
-        .upper_wall_texture = upper_wall_texture,
-        .lower_wall_texture = lower_wall_texture,
-        .ceil_texture = ceil_texture,
-        .floor_texture = floor_texture
+        .upper_wall_texture = side_textures->upper,
+        .lower_wall_texture = side_textures->lower,
+        .ceil_texture = front_flats->ceil,
+        .floor_texture = front_flats->floor,
+        .ceil_is_sky = front_flats->ceil_is_sky,
+        .floor_is_sky = front_flats->floor_is_sky
     };
 
-    r_draw_portal_wall_range(&desc);
+    r_draw_portal_wall_range(view->strip, &desc);
 }
 
-static void bsp_draw_solid_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sector_id, int16_t x1, int16_t x2, float rw_angle)
+static void bsp_draw_solid_wall_range(bsp_view_t *view, seg_t *seg, int16_t front_sector_id, int16_t x1, int16_t x2, angle_t rw_angle)
 {
+    if (x2 < view->strip->x_start || x1 > view->strip->x_end) return;
+
+    bsp_t *bsp = view->bsp;
+    const bsp_camera_t *camera = view->camera;
     sector_t *front_sector = &bsp->sectors[front_sector_id];
     linedef_t *line = &bsp->linedefs[seg->linedef_id];
     sidedef_t *side = NULL;
@@ -248,47 +360,39 @@ static void bsp_draw_solid_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sect
     else
         side = &bsp->sidedefs[line->front_sidedef_id];
 
-    char *wall_texture = side->mid_texture_name;
-    char *ceil_texture = front_sector->ceil_texture_name;
-    char *floor_texture = front_sector->floor_texture_name;
+    image_t *wall_texture = bsp->side_textures[side - bsp->sidedefs].mid;
+    sector_flats_t *front_flats = &bsp->sector_flats[front_sector_id];
     int16_t light_level = front_sector->light_level;
 
-    int16_t world_front_z1 = front_sector->ceil_z - camera_z;
-    int16_t world_front_z2 = front_sector->floor_z - camera_z;
+    int16_t world_front_z1 = front_sector->ceil_z - camera->z;
+    int16_t world_front_z2 = front_sector->floor_z - camera->z;
 
-    bool draw_wall = wall_texture[0] != '-';
+    bool draw_wall = wall_texture != NULL;
     bool draw_ceil = world_front_z1 > 0;
     bool draw_floor = world_front_z2 < 0;
 
-    float rw_normal_angle = u_convert_bams_to_radians(seg->angle) + PI_2;
-    float offset_angle = rw_normal_angle - rw_angle;
+    angle_t rw_normal = u_convert_bams(seg->angle) + ANG90;
+    angle_t offset_angle = rw_normal - rw_angle;
+    float rw_normal_angle = u_bam_to_radians(rw_normal);
 
     vertex_t *start_vertex = &bsp->vertexes[seg->start_vertex];
-    float dx = camera_x - start_vertex->x;
-    float dy = camera_y - start_vertex->y;
+    float dx = camera->x - start_vertex->x;
+    float dy = camera->y - start_vertex->y;
     float hypotenuse = sqrt(dx * dx + dy * dy);
-    float rw_distance = hypotenuse * cosf(offset_angle);
+    float rw_distance = hypotenuse * u_fine_cosine(offset_angle);
     
     float v_top = 0, middle_texture_alt = world_front_z1;
-    if (line->flags & LINE_DONT_PEG_BOTTOM)
+    if (draw_wall && (line->flags & LINE_DONT_PEG_BOTTOM))
     {
-        image_t *texture = a_get_texture_by_name(wall_texture);
-
-        if (texture == NULL) 
-        {
-            DOOM_LOG_ERROR("Nao foi possivel achar a textura %.8s", wall_texture);
-            return;
-        }
-
-        v_top = front_sector->floor_z + texture->height;
-        middle_texture_alt = v_top - camera_z;
+        v_top = front_sector->floor_z + wall_texture->height;
+        middle_texture_alt = v_top - camera->z;
     }
 
     middle_texture_alt += side->y_offset;
 
-    float rw_offset = hypotenuse * sin(offset_angle);
+    float rw_offset = hypotenuse * u_fine_sine(offset_angle);
     rw_offset += seg->offset + side->x_offset;
-    float rw_center_angle = rw_normal_angle - camera_angle;
+    float rw_center_angle = rw_normal_angle - camera->angle;
 
     solid_wall_desc_t desc = {
         .draw_wall = draw_wall,
@@ -296,112 +400,159 @@ static void bsp_draw_solid_wall_range(bsp_t *bsp, seg_t *seg, int16_t front_sect
         .draw_floor = draw_floor,
         .x1 = x1,
         .x2 = x2,
+        .seg_x1 = view->seg_x1,
+        .seg_x2 = view->seg_x2,
         .light_level = light_level,
         .rw_normal_angle = rw_normal_angle,
         .rw_distance = rw_distance,
         .middle_texture_alt = middle_texture_alt,
         .rw_offset = rw_offset,
         .rw_center_angle = rw_center_angle,
+        .seg_start = *start_vertex,
+        .seg_end = bsp->vertexes[seg->end_vertex],
         .world_front_z1 = world_front_z1,
         .world_front_z2 = world_front_z2,
         .wall_texture = wall_texture,
-        .ceil_texture = ceil_texture,
-        .floor_texture = floor_texture
+        .ceil_texture = front_flats->ceil,
+        .floor_texture = front_flats->floor,
+        .ceil_is_sky = front_flats->ceil_is_sky,
+        .floor_is_sky = front_flats->floor_is_sky
     };
 
-    r_draw_solid_wall_range(&desc);
+    r_draw_solid_wall_range(view->strip, &desc);
 }
 
-static void bsp_clip_portal_walls(bsp_t *bsp, seg_t *seg, int16_t front_sector_id, int16_t back_sector_id, int16_t x_start, int16_t x_end, float rw_angle)
+static int16_t bsp_visible_end(const bsp_view_t *view, const cliprange_t *next, int16_t last)
 {
-    if (bsp->screen_range.size <= 0)
+    // O desenho e o drawseg não incluem a última coluna do trecho: no sentinela da direita o trecho
+    // termina onde terminaria com uma faixa só, senão a última coluna de cada faixa mudaria
+    return next->first > view->strip->x_end ? last : next->first - 1;
+}
+
+static void bsp_clip_portal_walls(bsp_view_t *view, seg_t *seg, int16_t front_sector_id, int16_t back_sector_id, int16_t x_start, int16_t x_end, angle_t rw_angle)
+{
+    // Desenha só as partes visíveis, sem ocluir nada: o portal deixa ver o que está atrás
+    int16_t first = x_start, last = x_end - 1;
+    if (first > last) return;
+
+    cliprange_t *start = view->solid_segs;
+    while (start->last < first - 1)
+        start++;
+
+    if (first < start->first)
     {
-        bsp->running_traverse = false;
-        return;
+        if (last < start->first - 1)
+        {
+            bsp_draw_portal_wall_range(view, seg, front_sector_id, back_sector_id, first, last, rw_angle);
+            return;
+        }
+
+        bsp_draw_portal_wall_range(view, seg, front_sector_id, back_sector_id, first, bsp_visible_end(view, start, last), rw_angle);
     }
 
-    bsp->screen_range.curr = bsp->screen_range.head;
-    linked_list_t curr_wall = l_create_list_range(x_start, x_end);
-    linked_list_t intersection = l_intersection(&bsp->screen_range, &curr_wall);
-    if (intersection.size > 0)
+    if (last <= start->last) return;
+
+    while (last >= (start + 1)->first - 1)
     {
-        if (intersection.size != curr_wall.size)
-        {
-            int16_t x = x_start, last_element = x_start;
-            for (; intersection.curr != intersection.tail; l_next(&intersection))
-            {
-                int16_t curr_element = intersection.curr->next->element;
-                if (curr_element - last_element > 1)
-                {
-                    bsp_draw_portal_wall_range(bsp, seg, front_sector_id, back_sector_id, x, last_element, rw_angle);
-                    x = curr_element;
-                }
+        bsp_draw_portal_wall_range(view, seg, front_sector_id, back_sector_id, start->last + 1, bsp_visible_end(view, start + 1, last), rw_angle);
+        start++;
 
-                last_element = curr_element;
-            }
-            
-            // Desenha até o último elemento da interseção
-            bsp_draw_portal_wall_range(bsp, seg, front_sector_id, back_sector_id, x, intersection.curr->element, rw_angle);
-        }
-        else
-            bsp_draw_portal_wall_range(bsp, seg, front_sector_id, back_sector_id, x_start, x_end - 1, rw_angle);
-        
-        l_delete_list(&intersection);
+        if (last <= start->last) return;
     }
 
-    l_delete_list(&curr_wall);
+    bsp_draw_portal_wall_range(view, seg, front_sector_id, back_sector_id, start->last + 1, last, rw_angle);
 }
 
-static void bsp_clip_solid_wall(bsp_t *bsp, seg_t *seg, int16_t front_sector, int16_t x_start, int16_t x_end, float rw_angle)
+static void bsp_add_solid_wall(bsp_view_t *view, seg_t *seg, int16_t front_sector, int16_t x_start, int16_t x_end, angle_t rw_angle)
 {
-    if (bsp->screen_range.size > 0)
+    // Desenha as partes visíveis e junta o intervalo aos segmentos sólidos, mantendo a lista
+    // ordenada e sem intervalos vizinhos (dois intervalos sempre têm ao menos uma coluna livre entre eles)
+    int16_t first = x_start, last = x_end - 1;
+    if (first > last) return;
+
+    cliprange_t *start = view->solid_segs;
+    cliprange_t *end = view->solid_segs + view->solid_segs_count;
+    while (start->last < first - 1)
+        start++;
+
+    if (first < start->first)
     {
-        bsp->screen_range.curr = bsp->screen_range.head;
-        linked_list_t curr_wall = l_create_list_range(x_start, x_end);
-        linked_list_t intersection = l_intersection_remove(&bsp->screen_range, &curr_wall);
-        if (intersection.size > 0)
+        if (last < start->first - 1)
         {
-            if (intersection.size != curr_wall.size)
-            {
-                int16_t x = x_start, last_element = x_start;
-                for (; intersection.curr != intersection.tail; l_next(&intersection))
-                {
-                    int16_t curr_element = intersection.curr->next->element;
-                    if (curr_element - last_element > 1)
-                    {
-                        bsp_draw_solid_wall_range(bsp, seg, front_sector, x, last_element, rw_angle);
-                        x = curr_element;
-                    }
-                    
-                    last_element = curr_element;
-                }
-                
-                // Desenha até o último elemento da interseção
-                bsp_draw_solid_wall_range(bsp, seg, front_sector, x, intersection.curr->element, rw_angle);
-            }
-            else
-                bsp_draw_solid_wall_range(bsp, seg, front_sector, x_start, x_end - 1, rw_angle);
-            
-            l_delete_list(&intersection);
+            // Totalmente visível: vira um intervalo novo antes de start
+            bsp_draw_solid_wall_range(view, seg, front_sector, first, last, rw_angle);
+            memmove(start + 1, start, (end - start) * sizeof(cliprange_t));
+            start->first = first;
+            start->last = last;
+            view->solid_segs_count++;
+            return;
         }
 
-        l_delete_list(&curr_wall);
+        bsp_draw_solid_wall_range(view, seg, front_sector, first, bsp_visible_end(view, start, last), rw_angle);
+        start->first = first;
+    }
+
+    if (last <= start->last) return;
+
+    cliprange_t *next = start;
+    while (last >= (next + 1)->first - 1)
+    {
+        bsp_draw_solid_wall_range(view, seg, front_sector, next->last + 1, bsp_visible_end(view, next + 1, last), rw_angle);
+        next++;
+
+        if (last <= next->last)
+        {
+            start->last = next->last;
+            goto crunch;
+        }
+    }
+
+    bsp_draw_solid_wall_range(view, seg, front_sector, next->last + 1, last, rw_angle);
+    start->last = last;
+
+crunch:
+    // Remove os intervalos engolidos por start
+    if (next != start)
+    {
+        memmove(start + 1, next + 1, (end - (next + 1)) * sizeof(cliprange_t));
+        view->solid_segs_count -= next - start;
     }
-    else
-        bsp->running_traverse = false;
 }
 
-static void bsp_render_subsector(bsp_t *bsp, int16_t subsector_id)
+static void bsp_clip_solid_wall(bsp_view_t *view, seg_t *seg, int16_t front_sector, int16_t x_start, int16_t x_end, angle_t rw_angle)
 {
+    bsp_add_solid_wall(view, seg, front_sector, x_start, x_end, rw_angle);
+
+    // A faixa inteira já está coberta: nada mais atrás pode aparecer nela
+    const render_strip_t *strip = view->strip;
+    if (x_start <= strip->x_end && x_end - 1 >= strip->x_start && bsp_is_range_occluded(view, strip->x_start, strip->x_end))
+        view->running_traverse = false;
+}
+
+static void bsp_render_subsector(bsp_view_t *view, int16_t subsector_id)
+{
+    bsp_t *bsp = view->bsp;
     subsector_t *sub = &bsp->subsectors[subsector_id];
+
+    // As coisas do setor viram candidatas a sprite do frame
+    int16_t sector_id = bsp_get_subsector_sector_id(bsp, sub);
+    if (!view->visit->seen[sector_id])
+    {
+        view->visit->seen[sector_id] = 1;
+        view->visit->sectors[view->visit->count++] = sector_id;
+    }
+
     for (uint16_t i = 0; i < sub->seg_count; i++)
     {
         seg_t *seg = &bsp->segs[sub->first_seg_id + i];
         int16_t x1, x2;
-        float rw_angle;
-        if (bsp_add_segment_to_fov(bsp->vertexes[seg->start_vertex], bsp->vertexes[seg->end_vertex], &x1, &x2, &rw_angle))
+        angle_t rw_angle;
+        if (bsp_add_segment_to_fov(view->camera, bsp->vertexes[seg->start_vertex], bsp->vertexes[seg->end_vertex], &x1, &x2, &rw_angle))
         {
             if (x1 == x2) continue;
+
+            view->seg_x1 = x1;
+            view->seg_x2 = x2 - 1;
             
             int16_t front_sidedef, back_sidedef;
             
@@ -427,216 +578,398 @@ static void bsp_render_subsector(bsp_t *bsp, int16_t subsector_id)
                 if (front_sector->ceil_z != back_sector->ceil_z || 
                     front_sector->floor_z != back_sector->floor_z)
                 {
-                    bsp_clip_portal_walls(bsp, seg, front_sector_id, back_sector_id, x1, x2, rw_angle);
+                    bsp_clip_portal_walls(view, seg, front_sector_id, back_sector_id, x1, x2, rw_angle);
                 }
                     
                     
-                if (strcmp(front_sector->ceil_texture_name, back_sector->ceil_texture_name) == 0 &&
-                strcmp(back_sector->floor_texture_name, front_sector->floor_texture_name) == 0 &&
-                bsp->sidedefs[front_sidedef].mid_texture_name[0] == '-') 
+                sector_flats_t *front_flats = &bsp->sector_flats[front_sector_id];
+                sector_flats_t *back_flats = &bsp->sector_flats[back_sector_id];
+
+                if (front_flats->ceil == back_flats->ceil &&
+                back_flats->floor == front_flats->floor &&
+                bsp->side_textures[front_sidedef].mid == NULL) 
                 {
                     continue;
                 }
                 
-                bsp_clip_portal_walls(bsp, seg, front_sector_id, back_sector_id, x1, x2, rw_angle);
+                bsp_clip_portal_walls(view, seg, front_sector_id, back_sector_id, x1, x2, rw_angle);
             }
             else
-                bsp_clip_solid_wall(bsp, seg, front_sector_id, x1, x2, rw_angle);
+                bsp_clip_solid_wall(view, seg, front_sector_id, x1, x2, rw_angle);
         }
     }
 }
 
-static void bsp_render_traverse(bsp_t *bsp, int16_t node_id)
+static void bsp_render_traverse(bsp_view_t *view, int16_t node_id)
 {
-    if (!bsp->running_traverse) return;
+    if (!view->running_traverse) return;
 
     if (node_id & SUB_SECTOR_IDENTIFIER)
     {
         node_id = (node_id == -1) ? 0 : node_id & (~SUB_SECTOR_IDENTIFIER);
-        bsp_render_subsector(bsp, node_id);
+        bsp_render_subsector(view, node_id);
         return;
     }
 
-    node_t *node = &bsp->nodes[node_id];
+    node_t *node = &view->bsp->nodes[node_id];
 
-    if (bsp_point_on_side(node))
+    if (bsp_point_on_side(view->camera, node))
     {
-        bsp_render_traverse(bsp, node->left_child);
-        if (bsp_check_box(&node->right_bbox))
-            bsp_render_traverse(bsp, node->right_child);
+        bsp_render_traverse(view, node->left_child);
+        if (bsp_check_box(view, &node->right_bbox))
+            bsp_render_traverse(view, node->right_child);
     }
     else
     {
-        bsp_render_traverse(bsp, node->right_child);
-        if (bsp_check_box(&node->left_bbox))
-            bsp_render_traverse(bsp, node->left_child);
+        bsp_render_traverse(view, node->right_child);
+        if (bsp_check_box(view, &node->left_bbox))
+            bsp_render_traverse(view, node->left_child);
     }
 }
 
-bsp_t bsp_create(wad_reader_t *wdr, const char* level_name)
+static image_t *bsp_resolve_texture(const char *name)
 {
-    bsp_t bsp = {0};
-    uint32_t level_idx = 0;
-    if (fh_get_value(&wdr->file_hash, level_name, &level_idx))
+    if (name[0] == '-') return NULL;
+
+    image_t *texture = a_pin_texture_by_name(name);
+    if (texture == NULL)
     {
-        uint32_t nodes_size = 0;
-        bsp.nodes = (node_t*)wdr_get_lump_data(wdr, level_idx + NODES_INDEX, 0, &nodes_size);
-        nodes_size /= sizeof(node_t);
-        bsp.root_id = nodes_size - 1;
-
-        bsp.sectors = (sector_t*)wdr_get_lump_data(wdr, level_idx + SECTORS_INDEX, 0, NULL);
-        bsp.subsectors = (subsector_t*)wdr_get_lump_data(wdr, level_idx + SUBSECTORS_INDEX, 0, NULL);
-        bsp.segs = (seg_t*)wdr_get_lump_data(wdr, level_idx + SEGS_INDEX, 0, NULL);
-        bsp.vertexes = (vertex_t*)wdr_get_lump_data(wdr, level_idx + VERTEXES_INDEX, 0, NULL);
-        bsp.linedefs = (linedef_t*)wdr_get_lump_data(wdr, level_idx + LINEDEFS_INDEX, 0, NULL);
-        bsp.sidedefs = (sidedef_t*)wdr_get_lump_data(wdr, level_idx + SIDEDEFS_INDEX, 0, NULL);
-
-        uint32_t entities_count = 0;
-        bsp.entities = (entity_t*)wdr_get_lump_data(wdr, level_idx + ENTITIES_INDEX, 0, &entities_count);
-        entities_count /= sizeof(entity_t);
-        bsp.entities_count = entities_count;
-
-        camera_x = bsp.entities[0].pos_x;
-        camera_y = bsp.entities[0].pos_y;
-        camera_z = bsp_get_sub_sector_height(&bsp);
+        DOOM_LOG_WARN("Textura %.8s nao encontrada", name);
     }
 
-    return bsp;
+    return texture;
 }
 
-int16_t bsp_get_sub_sector_height(bsp_t *bsp)
+static image_t *bsp_resolve_flat(const char *name, bool *is_sky)
 {
-    int16_t sub_sector_id = bsp->root_id;
+    // O céu não é um flat: é desenhado com a textura SKY1
+    *is_sky = strncmp(name, "F_SKY1", 8) == 0;
+    image_t *flat = *is_sky ? a_pin_texture_by_name("SKY1") : a_pin_flat_by_name(name);
 
-    while((sub_sector_id & SUB_SECTOR_IDENTIFIER) == 0)
+    if (flat == NULL)
     {
-        node_t *node = &bsp->nodes[sub_sector_id];
-        sub_sector_id = bsp_point_on_side(node) ? node->left_child : node->right_child;
+        DOOM_LOG_WARN("Flat %.8s nao encontrado", name);
     }
 
-    sub_sector_id = (sub_sector_id == -1) ? 0 : sub_sector_id & (~SUB_SECTOR_IDENTIFIER);
-    subsector_t *subsector = &bsp->subsectors[sub_sector_id];
-    seg_t *seg = &bsp->segs[subsector->first_seg_id];
+    return flat;
+}
 
-    int16_t front_sidedef = seg->direction ? bsp->linedefs[seg->linedef_id].back_sidedef_id 
-                                                            : 
-                                            bsp->linedefs[seg->linedef_id].front_sidedef_id;
+// Resolve os nomes de texturas do nível uma única vez, para que o frame não faça hash nem comparação de
+// strings. As texturas ficam residentes e presas (protegidas do despejo) até o bsp_delete
+static bool bsp_resolve_textures(bsp_t *bsp)
+{
+    bsp->side_textures = (side_textures_t*)ar_alloc(&bsp->arena, bsp->sidedefs_count * sizeof(side_textures_t), AR_CACHE_LINE);
+    bsp->sector_flats = (sector_flats_t*)ar_alloc(&bsp->arena, bsp->sectors_count * sizeof(sector_flats_t), AR_CACHE_LINE);
+
+    if (bsp->side_textures == NULL || bsp->sector_flats == NULL)
+        return false;
+
+    for (uint32_t i = 0; i < bsp->sidedefs_count; i++)
+    {
+        sidedef_t *side = &bsp->sidedefs[i];
+        bsp->side_textures[i] = (side_textures_t){
+            .upper = bsp_resolve_texture(side->upper_texture_name),
+            .lower = bsp_resolve_texture(side->lower_texture_name),
+            .mid = bsp_resolve_texture(side->mid_texture_name),
+        };
+    }
 
-    int16_t front_sector_id = bsp->sidedefs[front_sidedef].sector_id;
-    return bsp->sectors[front_sector_id].floor_z;
+    for (uint32_t i = 0; i < bsp->sectors_count; i++)
+    {
+        sector_t *sector = &bsp->sectors[i];
+        sector_flats_t *flats = &bsp->sector_flats[i];
+        flats->ceil = bsp_resolve_flat(sector->ceil_texture_name, &flats->ceil_is_sky);
+        flats->floor = bsp_resolve_flat(sector->floor_texture_name, &flats->floor_is_sky);
+    }
+
+    return true;
 }
 
-int16_t bsp_get_sub_sector_height_for_ent(bsp_t *bsp, int16_t x, int16_t y)
+// Encadeia as coisas do nível pelo setor em que estão, para que o frame só olhe as dos setores visitados
+// sem descer a BSP por entidade. A primeira entidade é o início do jogador e fica de fora
+static bool bsp_link_things(bsp_t *bsp)
 {
-    int16_t sub_sector_id = bsp->root_id;
+    bsp->sector_things = (int16_t*)ar_alloc(&bsp->arena, bsp->sectors_count * sizeof(int16_t), AR_CACHE_LINE);
+    bsp->thing_next = (int16_t*)ar_alloc(&bsp->arena, bsp->entities_count * sizeof(int16_t), AR_CACHE_LINE);
 
-    while((sub_sector_id & SUB_SECTOR_IDENTIFIER) == 0)
+    if (bsp->sector_things == NULL || bsp->thing_next == NULL)
+        return false;
+
+    memset(bsp->sector_things, 0xFF, bsp->sectors_count * sizeof(int16_t));
+    bsp->thing_next[0] = -1;
+
+    for (int16_t i = bsp->entities_count - 1; i > 0; i--)
     {
-        node_t *node = &bsp->nodes[sub_sector_id];
-        int16_t dx = x - node->x_partition;
-        int16_t dy = y - node->y_partition;
-        sub_sector_id = (dx * node->dy_partition - dy * node->dx_partition) <= 0 ? node->left_child : node->right_child;
+        int16_t sector_id = bsp_get_sector_id_at(bsp, bsp->entities[i].pos_x, bsp->entities[i].pos_y);
+        bsp->thing_next[i] = bsp->sector_things[sector_id];
+        bsp->sector_things[sector_id] = i;
     }
 
-    sub_sector_id = (sub_sector_id == -1) ? 0 : sub_sector_id & (~SUB_SECTOR_IDENTIFIER);
-    subsector_t *subsector = &bsp->subsectors[sub_sector_id];
-    seg_t *seg = &bsp->segs[subsector->first_seg_id];
+    return true;
+}
 
-    int16_t front_sidedef = seg->direction ? bsp->linedefs[seg->linedef_id].back_sidedef_id 
-                                                            : 
-                                            bsp->linedefs[seg->linedef_id].front_sidedef_id;
+static void *bsp_copy_lump(arena_t *arena, lump_view_t view)
+{
+    void *data = ar_alloc(arena, view.size, AR_CACHE_LINE);
+    if (data != NULL && view.size > 0)
+        memcpy(data, view.data, view.size);
 
-    int16_t front_sector_id = bsp->sidedefs[front_sidedef].sector_id;
-    return bsp->sectors[front_sector_id].floor_z;
+    return data;
+}
+
+bsp_t bsp_create(wad_reader_t *wdr, const char* level_name)
+{
+    bsp_t bsp = {0};
+    uint32_t level_idx = 0;
+    if (fh_get_value(&wdr->file_hash, level_name, &level_idx))
+    {
+        lump_view_t nodes = wdr_get_lump_view(wdr, level_idx + NODES_INDEX, 0);
+        lump_view_t sectors = wdr_get_lump_view(wdr, level_idx + SECTORS_INDEX, 0);
+        lump_view_t subsectors = wdr_get_lump_view(wdr, level_idx + SUBSECTORS_INDEX, 0);
+        lump_view_t segs = wdr_get_lump_view(wdr, level_idx + SEGS_INDEX, 0);
+        lump_view_t vertexes = wdr_get_lump_view(wdr, level_idx + VERTEXES_INDEX, 0);
+        lump_view_t linedefs = wdr_get_lump_view(wdr, level_idx + LINEDEFS_INDEX, 0);
+        lump_view_t sidedefs = wdr_get_lump_view(wdr, level_idx + SIDEDEFS_INDEX, 0);
+        lump_view_t entities = wdr_get_lump_view(wdr, level_idx + ENTITIES_INDEX, 0);
+
+        if (sectors.data == NULL || subsectors.data == NULL || segs.data == NULL || vertexes.data == NULL ||
+            linedefs.data == NULL || sidedefs.data == NULL || entities.size < sizeof(entity_t))
+        {
+            DOOM_LOG_ERROR("Nivel %s incompleto no WAD", level_name);
+            return bsp;
+        }
+
+        bsp.sectors_count = sectors.size / sizeof(sector_t);
+        bsp.sidedefs_count = sidedefs.size / sizeof(sidedef_t);
+
+        // Lumps e tabelas derivadas do nível ficam em um único bloco, liberado de uma vez em bsp_delete.
+        // A cópia também alinha os lumps, que no WAD podem começar em qualquer byte
+        lump_view_t lumps[] = { nodes, sectors, subsectors, segs, vertexes, linedefs, sidedefs, entities };
+        size_t level_size = AR_ALIGN_UP(bsp.sidedefs_count * sizeof(side_textures_t), AR_CACHE_LINE) +
+                            AR_ALIGN_UP(bsp.sectors_count * sizeof(sector_flats_t), AR_CACHE_LINE) +
+                            AR_ALIGN_UP(bsp.sectors_count * sizeof(int16_t), AR_CACHE_LINE) +
+                            AR_ALIGN_UP(entities.size / sizeof(entity_t) * sizeof(int16_t), AR_CACHE_LINE);
+        for (uint32_t i = 0; i < sizeof(lumps) / sizeof(lumps[0]); i++)
+            level_size += AR_ALIGN_UP(lumps[i].size, AR_CACHE_LINE);
+
+        bsp.arena = ar_create(level_size, false);
+        if (bsp.arena.base == NULL)
+        {
+            DOOM_LOG_ERROR("Nao foi possivel alocar a memoria do nivel %s", level_name);
+            return bsp;
+        }
+
+        bsp.nodes = (node_t*)bsp_copy_lump(&bsp.arena, nodes);
+        bsp.root_id = nodes.size / sizeof(node_t) - 1;
+
+        bsp.sectors = (sector_t*)bsp_copy_lump(&bsp.arena, sectors);
+        bsp.subsectors = (subsector_t*)bsp_copy_lump(&bsp.arena, subsectors);
+        bsp.segs = (seg_t*)bsp_copy_lump(&bsp.arena, segs);
+        bsp.vertexes = (vertex_t*)bsp_copy_lump(&bsp.arena, vertexes);
+        bsp.linedefs = (linedef_t*)bsp_copy_lump(&bsp.arena, linedefs);
+        bsp.sidedefs = (sidedef_t*)bsp_copy_lump(&bsp.arena, sidedefs);
+
+        bsp.entities = (entity_t*)bsp_copy_lump(&bsp.arena, entities);
+        bsp.entities_count = entities.size / sizeof(entity_t);
+
+        if (!bsp_resolve_textures(&bsp))
+        {
+            DOOM_LOG_ERROR("Nao foi possivel resolver as texturas do nivel %s", level_name);
+            bsp_delete(&bsp);
+        }
+        else if (!bsp_link_things(&bsp))
+        {
+            DOOM_LOG_ERROR("Nao foi possivel montar as listas de coisas do nivel %s", level_name);
+            bsp_delete(&bsp);
+        }
+    }
+
+    return bsp;
+}
+
+int16_t bsp_get_sub_sector_height_for_ent(bsp_t *bsp, int16_t x, int16_t y)
+{
+    return bsp_get_sector_at(bsp, x, y)->floor_z;
+}
+
+int16_t bsp_get_sub_sector_light(bsp_t *bsp)
+{
+    return bsp_get_sector_at(bsp, bsp->camera.x, bsp->camera.y)->light_level;
 }
 
 vec3f_t bsp_get_player_spawn(bsp_t *bsp)
 {
-    int16_t sector_height = bsp_get_sub_sector_height(bsp);
-    return (vec3f_t) { camera_x, camera_y, camera_z };
+    // Não depende da câmera, então pode ser chamada para um nível ainda não ativo
+    entity_t *player_start = &bsp->entities[0];
+    int16_t floor_z = bsp_get_sub_sector_height_for_ent(bsp, player_start->pos_x, player_start->pos_y);
+    return (vec3f_t) { player_start->pos_x, player_start->pos_y, floor_z };
 }
 
 void bsp_update(bsp_t *bsp, vec3f_t pos, float angle)
 {
-    camera_x = (int16_t)pos.x;
-    camera_y = (int16_t)pos.y;
-    camera_z = (int16_t)pos.z;
-    camera_angle = angle;
+    bsp->camera = (bsp_camera_t) {
+        .x = (int16_t)pos.x,
+        .y = (int16_t)pos.y,
+        .z = (int16_t)pos.z,
+        .angle = angle,
+        .cos = cosf(angle),
+        .sin = sinf(angle),
+        .view_angle = u_radians_to_bam(angle)
+    };
 }
 
-void bsp_render(bsp_t *bsp)
+static void bsp_render_strip(void *ctx, uint32_t index)
 {
-    bsp->running_traverse = true;
-    bsp->screen_range = l_create_list_range(0, r_get_width());
+    bsp_t *bsp = (bsp_t*)ctx;
+    bsp_view_t view = { .bsp = bsp, .camera = &bsp->camera, .strip = r_get_strip(index), .running_traverse = true };
+    view.visit = &view.bsp->sector_visits[index];
+    view.visit->count = 0;
+
+    // Pior caso: colunas sólidas e livres alternadas dentro da faixa, mais os dois sentinelas
+    uint16_t width = view.strip->x_end - view.strip->x_start + 1;
+    view.solid_segs = ar_alloc(&view.strip->arena, (width / 2 + 3) * sizeof(cliprange_t), AR_CACHE_LINE);
+    view.visit->sectors = ar_alloc(&view.strip->arena, view.bsp->sectors_count * sizeof(int16_t), AR_CACHE_LINE);
+    view.visit->seen = ar_alloc(&view.strip->arena, view.bsp->sectors_count, AR_CACHE_LINE);
+    if (view.solid_segs == NULL || view.visit->sectors == NULL || view.visit->seen == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel alocar o estado da travessia do frame");
+        return;
+    }
 
-    bsp_render_traverse(bsp, bsp->root_id);
+    memset(view.visit->seen, 0, view.bsp->sectors_count);
+    view.solid_segs[0] = (cliprange_t) { INT16_MIN, view.strip->x_start - 1 };
+    view.solid_segs[1] = (cliprange_t) { view.strip->x_end + 1, INT16_MAX };
+    view.solid_segs_count = 2;
 
-    bsp->running_traverse = false;
-    l_delete_list(&bsp->screen_range);
+    bsp_render_traverse(&view, view.bsp->root_id);
+    r_draw_planes(view.strip);
 }
 
-void bsp_render_sprites(bsp_t *bsp)
+void bsp_render(bsp_t *bsp)
 {
+    bsp->sector_visits = ar_alloc(r_get_frame_arena(), r_get_strip_count() * sizeof(bsp_sector_visit_t), AR_CACHE_LINE);
+    if (bsp->sector_visits == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel alocar os setores visitados do frame");
+        return;
+    }
 
-    vertex_t min, max;
+    // Cada faixa percorre a BSP por conta própria e só desenha as próprias colunas
+    j_parallel_for(r_get_strip_count(), bsp_render_strip, bsp);
+}
 
-    // Número de entidades carregadas
-    // (Supondo que você tenha um campo bsp.num_entities)
-    for (int i = 1; i < bsp->entities_count; i++) 
+static void bsp_draw_sprites_strip(void *ctx, uint32_t index)
+{
+    const bsp_sprite_list_t *list = (const bsp_sprite_list_t*)ctx;
+    render_strip_t *strip = r_get_strip(index);
+
+    for (uint16_t i = 0; i < list->count; i++)
     {
-        entity_t *ent = &bsp->entities[i];
-        
-        // Calcula vetor da câmera para a entidade
-        float dx = ent->pos_x - camera_x;
-        float dy = ent->pos_y - camera_y;
-        float dist = sqrtf(dx*dx + dy*dy);
-
-        // Calcula o ângulo relativo entre a câmera e o sprite
-        float angle_to_sprite = u_normalize_angle(atan2f(dy, dx));
-        float rw_angle = angle_to_sprite;
-        
-        angle_to_sprite -= camera_angle;
-
-        float tspan1 = u_normalize_angle(angle_to_sprite + H_FOV);
-        float tspan2 = u_normalize_angle(H_FOV - angle_to_sprite);
-        if (tspan1 > FOV || tspan2 > FOV)
-            continue;
-
-        int16_t x = r_angle_to_x(angle_to_sprite);
-        
-        image_t *sprite = a_get_sprite_by_type(ent->type);
-        if (sprite != NULL)
-        {
-            int16_t z1 = bsp_get_sub_sector_height_for_ent(bsp, ent->pos_x, ent->pos_y) - camera_z;
-            float rw_scale = r_scale_from_global_angle(x, rw_angle, dist);
-            r_draw_sprite(x, z1, sprite, rw_scale, dist);
-        }
+        const bsp_sprite_t *sprite = &list->sprites[i];
+        r_draw_sprite(strip, sprite->x, sprite->z, sprite->image, sprite->rw_scale, sprite->position, sprite->light_level);
     }
 }
 
-void bsp_delete(bsp_t *bsp)
+static void bsp_project_sprite(bsp_t *bsp, int16_t thing, int16_t sector_id, uint64_t animation_tick, bsp_sprite_list_t *list)
 {
-    if (bsp->entities != NULL)
-        free(bsp->entities);
+    entity_t *ent = &bsp->entities[thing];
+    const bsp_camera_t *camera = &bsp->camera;
+
+    // Posição no espaço da câmera: tz ao longo da visão, tx positivo à direita
+    float tr_x = ent->pos_x - camera->x;
+    float tr_y = ent->pos_y - camera->y;
+    float tz = tr_x * camera->cos + tr_y * camera->sin;
+    if (tz < MIN_SPRITE_Z)
+        return;
 
-    if (bsp->nodes != NULL)
-        free(bsp->nodes);
+    image_t *sprite = a_get_sprite_by_type(ent->type, animation_tick);
+    if (sprite == NULL)
+        return;
 
-    if (bsp->subsectors != NULL)
-        free(bsp->subsectors);
+    float tx = tr_x * camera->sin - tr_y * camera->cos;
+    float scale = r_get_screen_dist() / tz;
+    float x = r_get_width() / 2.f + tx * scale;
+    float half_width = sprite->width * scale / 2;
+    if (x + half_width < 0 || x - half_width > r_get_width())
+        return;
 
-    if (bsp->sectors != NULL)
-        free(bsp->sectors);
+    sector_t *sector = &bsp->sectors[sector_id];
+    list->sprites[list->count++] = (bsp_sprite_t) {
+        .image = sprite,
+        .x = x,
+        .z = sector->floor_z - camera->z,
+        .light_level = sector->light_level,
+        .rw_scale = scale,
+        .position = (vertex_t) { ent->pos_x, ent->pos_y }
+    };
+}
+
+static int bsp_compare_sprites(const void *a, const void *b)
+{
+    float scale_a = ((const bsp_sprite_t*)a)->rw_scale;
+    float scale_b = ((const bsp_sprite_t*)b)->rw_scale;
+    return (scale_a > scale_b) - (scale_a < scale_b);
+}
 
-    if (bsp->segs != NULL)
-        free(bsp->segs);
+void bsp_render_sprites(bsp_t *bsp, uint64_t animation_tick)
+{
+    // Só vale logo depois do bsp_render do mesmo frame: as listas de visita estão na arena do frame
+    bsp_sector_visit_t *visits = bsp->sector_visits;
+    bsp->sector_visits = NULL;
+    if (visits == NULL)
+        return;
 
-    if (bsp->vertexes != NULL)
-        free(bsp->vertexes);
+    // Os sprites são escolhidos uma vez no thread principal (o quadro da animação depende do relógio)
+    // e desenhados depois por faixa, como as paredes
+    arena_t *arena = r_get_frame_arena();
+    bsp_sprite_list_t list = { .count = 0 };
+    list.sprites = ar_alloc(arena, bsp->entities_count * sizeof(bsp_sprite_t), AR_CACHE_LINE);
+    uint8_t *added = ar_alloc(arena, bsp->sectors_count, AR_CACHE_LINE);
+    if (list.sprites == NULL || added == NULL)
+        return;
 
-    if (bsp->linedefs != NULL)
-        free(bsp->linedefs);
+    // Um setor visto por qualquer faixa entra para todas, senão um sprite que cruza a borda de uma
+    // faixa seria cortado nela
+    memset(added, 0, bsp->sectors_count);
+    for (uint16_t s = 0; s < r_get_strip_count(); s++)
+    {
+        for (uint32_t i = 0; i < visits[s].count; i++)
+        {
+            int16_t sector_id = visits[s].sectors[i];
+            if (added[sector_id]) continue;
+            added[sector_id] = 1;
 
-    if (bsp->sidedefs != NULL)
-        free(bsp->sidedefs);
+            for (int16_t thing = bsp->sector_things[sector_id]; thing != -1; thing = bsp->thing_next[thing])
+                bsp_project_sprite(bsp, thing, sector_id, animation_tick, &list);
+        }
+    }
+
+    // Do mais distante para o mais próximo, para que os da frente cubram os de trás
+    qsort(list.sprites, list.count, sizeof(bsp_sprite_t), bsp_compare_sprites);
+
+    j_parallel_for(r_get_strip_count(), bsp_draw_sprites_strip, &list);
 }
+
+void bsp_delete(bsp_t *bsp)
+{
+    // Libera as texturas do nível para o despejo
+    if (bsp->sector_flats != NULL)
+    {
+        for (uint32_t i = 0; i < bsp->sidedefs_count; i++)
+        {
+            side_textures_t *side = &bsp->side_textures[i];
+            if (side->upper != NULL) a_unpin_image(side->upper);
+            if (side->lower != NULL) a_unpin_image(side->lower);
+            if (side->mid != NULL) a_unpin_image(side->mid);
+        }
+
+        for (uint32_t i = 0; i < bsp->sectors_count; i++)
+        {
+            if (bsp->sector_flats[i].ceil != NULL) a_unpin_image(bsp->sector_flats[i].ceil);
+            if (bsp->sector_flats[i].floor != NULL) a_unpin_image(bsp->sector_flats[i].floor);
+        }
+    }
+
+    ar_destroy(&bsp->arena);
+    *bsp = (bsp_t){0};
+}
\ No newline at end of file
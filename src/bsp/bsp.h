@@ -2,12 +2,36 @@
 #define BSP_H_INCLUDED
 
 #include "typedefs.h"
-#include "linked_list.h"
 #include "wad/wad_reader.h"
+#include "assets/image.h"
+#include "core/arena.h"
+
+// Texturas de um sidedef resolvidas no carregamento do nível (NULL para "-" ou nome desconhecido)
+typedef struct _side_textures
+{
+    image_t *upper, *lower, *mid;
+} side_textures_t;
+
+// Flats de um setor; um teto de céu aponta para a textura SKY1
+typedef struct _sector_flats
+{
+    image_t *floor, *ceil;
+    bool floor_is_sky, ceil_is_sky;
+} sector_flats_t;
+
+// Câmera do frame, gravada por bsp_update no próprio bsp; a travessia só lê daqui
+typedef struct _bsp_camera
+{
+    int16_t x, y, z;
+    float angle, cos, sin;
+    angle_t view_angle;
+} bsp_camera_t;
 
 typedef struct _bsp
 {
     int16_t root_id, entities_count;
+    uint32_t sectors_count, sidedefs_count;
+    arena_t arena;
     node_t *nodes;
     subsector_t *subsectors;
     sector_t *sectors;
@@ -15,17 +39,23 @@ typedef struct _bsp
     vertex_t *vertexes;
     linedef_t *linedefs;
     sidedef_t *sidedefs;
+    side_textures_t *side_textures;
+    sector_flats_t *sector_flats;
     entity_t *entities;
-    bool running_traverse;
-    linked_list_t screen_range;
+    // Coisas de cada setor, encadeadas no carregamento: primeira do setor e próxima do mesmo setor (-1 no fim)
+    int16_t *sector_things, *thing_next;
+    // Setores alcançados por cada faixa na última travessia; válidos só até o bsp_render_sprites do frame
+    struct _bsp_sector_visit *sector_visits;
+    bsp_camera_t camera;
 } bsp_t;
 
 bsp_t bsp_create(wad_reader_t *wdr, const char* level_name);
-int16_t bsp_get_sub_sector_height(bsp_t *bsp);
+int16_t bsp_get_sub_sector_height_for_ent(bsp_t *bsp, int16_t x, int16_t y);
+int16_t bsp_get_sub_sector_light(bsp_t *bsp);
 vec3f_t bsp_get_player_spawn(bsp_t *bsp);
 void bsp_update(bsp_t *bsp, vec3f_t pos, float angle);
 void bsp_render(bsp_t *bsp);
-void bsp_render_sprites(bsp_t *bsp);
+void bsp_render_sprites(bsp_t *bsp, uint64_t animation_tick);
 void bsp_delete(bsp_t *bsp);
 
 #endif
\ No newline at end of file
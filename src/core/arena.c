@@ -0,0 +1,89 @@
+#include "arena.h"
+
+static uint8_t *ar_create_base(size_t capacity)
+{
+    // aligned_alloc exige um tamanho múltiplo do alinhamento
+    return (uint8_t*)aligned_alloc(AR_CACHE_LINE, AR_ALIGN_UP(capacity > 0 ? capacity : 1, AR_CACHE_LINE));
+}
+
+arena_t ar_create(size_t capacity, bool growable)
+{
+    arena_t arena = { .base = NULL, .capacity = capacity, .offset = 0, .overflow_bytes = 0, .overflow = NULL, .growable = growable };
+
+    arena.base = ar_create_base(capacity);
+    if (arena.base == NULL)
+        arena.capacity = 0;
+
+    return arena;
+}
+
+static void *ar_alloc_overflow(arena_t *arena, size_t size, size_t alignment)
+{
+    size_t header = AR_ALIGN_UP(sizeof(arena_block_t), alignment);
+    arena_block_t *block = (arena_block_t*)malloc(header + size + alignment);
+    if (block == NULL) return NULL;
+
+    block->next = arena->overflow;
+    arena->overflow = block;
+    arena->overflow_bytes += size + alignment;
+
+    return (void*)AR_ALIGN_UP((uintptr_t)block + header, alignment);
+}
+
+void *ar_alloc(arena_t *arena, size_t size, size_t alignment)
+{
+    // O bloco base é alinhado em AR_CACHE_LINE, então alinhar o offset basta
+    size_t offset = AR_ALIGN_UP(arena->offset, alignment);
+
+    if (arena->base != NULL && offset + size <= arena->capacity)
+    {
+        arena->offset = offset + size;
+        return arena->base + offset;
+    }
+
+    return arena->growable ? ar_alloc_overflow(arena, size, alignment) : NULL;
+}
+
+static void ar_free_overflow(arena_t *arena)
+{
+    while (arena->overflow != NULL)
+    {
+        arena_block_t *next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+}
+
+void ar_reset(arena_t *arena)
+{
+    ar_free_overflow(arena);
+
+    if (arena->overflow_bytes > 0)
+    {
+        size_t capacity = arena->capacity + arena->overflow_bytes;
+        uint8_t *base = ar_create_base(capacity);
+
+        if (base != NULL)
+        {
+            free(arena->base);
+            arena->base = base;
+            arena->capacity = capacity;
+        }
+
+        arena->overflow_bytes = 0;
+    }
+
+    arena->offset = 0;
+}
+
+size_t ar_get_used(const arena_t *arena)
+{
+    return arena->offset + arena->overflow_bytes;
+}
+
+void ar_destroy(arena_t *arena)
+{
+    ar_free_overflow(arena);
+    free(arena->base);
+    *arena = (arena_t){0};
+}
@@ -0,0 +1,33 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include "typedefs.h"
+
+#define AR_CACHE_LINE 64
+
+typedef struct _arena_block
+{
+    struct _arena_block *next;
+} arena_block_t;
+
+// Alocador linear: tudo é liberado de uma vez em ar_reset/ar_destroy.
+// Uma arena que pode crescer atende o excesso com blocos extras e, no próximo ar_reset,
+// passa a ter um bloco único do tamanho do pico (o estado estável não faz nenhum malloc)
+typedef struct _arena
+{
+    uint8_t *base;
+    size_t capacity, offset;
+    size_t overflow_bytes;
+    arena_block_t *overflow;
+    bool growable;
+} arena_t;
+
+arena_t ar_create(size_t capacity, bool growable);
+void *ar_alloc(arena_t *arena, size_t size, size_t alignment);
+void ar_reset(arena_t *arena);
+size_t ar_get_used(const arena_t *arena);
+void ar_destroy(arena_t *arena);
+
+#define AR_ALIGN_UP(_size, _alignment) (((_size) + (_alignment) - 1) & ~((size_t)(_alignment) - 1))
+
+#endif
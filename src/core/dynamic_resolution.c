@@ -0,0 +1,104 @@
+#include "dynamic_resolution.h"
+#include "logger.h"
+#include <math.h>
+
+#define DR_SMOOTHING 0.1
+#define DR_HEADROOM 0.9     // Ao descer, mira um pouco abaixo do orçamento
+#define DR_RAISE_BELOW 0.75 // Só sobe com o frame abaixo de 75% do orçamento
+#define DR_DROP_COOLDOWN 8
+#define DR_RAISE_COOLDOWN 30
+
+typedef struct _dynamic_resolution
+{
+    bool enabled;
+    uint16_t max_w, max_h;
+    uint8_t level, min_level;
+    uint32_t cooldown;
+    double budget_ms, average_ms;
+} dynamic_resolution_t;
+
+static dynamic_resolution_t dynamic_resolution = {0};
+
+static uint8_t dr_width_to_level(uint16_t max_w, uint16_t width)
+{
+    int32_t level = (int32_t)lroundf(width * DR_LEVELS / (float)max_w);
+    return level < 1 ? 1 : level > DR_LEVELS ? DR_LEVELS : level;
+}
+
+bool dr_init(uint16_t max_w, uint16_t max_h, uint16_t min_w, uint16_t start_w, float budget_ms)
+{
+    dynamic_resolution = (dynamic_resolution_t){0};
+    if (max_w == 0 || max_h == 0 || budget_ms <= 0.f)
+        return false;
+
+    dynamic_resolution.max_w = max_w;
+    dynamic_resolution.max_h = max_h;
+    dynamic_resolution.min_level = dr_width_to_level(max_w, min_w);
+    dynamic_resolution.level = dr_width_to_level(max_w, start_w);
+    if (dynamic_resolution.level < dynamic_resolution.min_level)
+        dynamic_resolution.level = dynamic_resolution.min_level;
+    dynamic_resolution.budget_ms = budget_ms;
+    dynamic_resolution.cooldown = DR_RAISE_COOLDOWN;
+    dynamic_resolution.enabled = true;
+
+    DOOM_LOG_INFO("Resolucao dinamica: %.2f ms por frame, de %ux%u a %ux%u", budget_ms,
+        max_w * dynamic_resolution.min_level / DR_LEVELS, max_h * dynamic_resolution.min_level / DR_LEVELS, max_w, max_h);
+    return true;
+}
+
+bool dr_update(double frame_ms)
+{
+    dynamic_resolution_t *dr = &dynamic_resolution;
+    if (!dr->enabled)
+        return false;
+
+    dr->average_ms = dr->average_ms == 0 ? frame_ms : dr->average_ms + (frame_ms - dr->average_ms) * DR_SMOOTHING;
+    if (dr->cooldown > 0)
+    {
+        dr->cooldown--;
+        return false;
+    }
+
+    // O custo cresce com a área, então a escala em cada eixo segue a raiz da razão de tempos
+    uint8_t level = dr->level;
+    if (dr->average_ms > dr->budget_ms && level > dr->min_level)
+    {
+        int32_t target = (int32_t)(level * sqrt(dr->budget_ms * DR_HEADROOM / dr->average_ms));
+        if (target >= level) target = level - 1;
+        level = target < dr->min_level ? dr->min_level : target;
+        dr->cooldown = DR_DROP_COOLDOWN;
+    }
+    else if (dr->average_ms < dr->budget_ms * DR_RAISE_BELOW && level < DR_LEVELS)
+    {
+        // Não sobe se a estimativa no nível seguinte já estouraria: evita oscilar entre dois níveis
+        double ratio = (level + 1) / (double)level;
+        if (dr->average_ms * ratio * ratio < dr->budget_ms * DR_HEADROOM)
+            level++;
+        dr->cooldown = DR_RAISE_COOLDOWN;
+    }
+
+    if (level == dr->level)
+        return false;
+
+    // A média segue a estimativa do novo nível até as próximas medidas corrigirem
+    double ratio = level / (double)dr->level;
+    dr->average_ms *= ratio * ratio;
+    dr->level = level;
+    DOOM_LOG_DEBUG("Resolucao dinamica: %ux%u", dr_get_width(), dr_get_height());
+    return true;
+}
+
+bool dr_is_enabled()
+{
+    return dynamic_resolution.enabled;
+}
+
+uint16_t dr_get_width()
+{
+    return dynamic_resolution.max_w * dynamic_resolution.level / DR_LEVELS;
+}
+
+uint16_t dr_get_height()
+{
+    return dynamic_resolution.max_h * dynamic_resolution.level / DR_LEVELS;
+}
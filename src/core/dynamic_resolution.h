@@ -0,0 +1,18 @@
+#ifndef DYNAMIC_RESOLUTION_H_INCLUDED
+#define DYNAMIC_RESOLUTION_H_INCLUDED
+
+#include "typedefs.h"
+
+// Passos de resolução: nível k desenha em max * k / DR_LEVELS (em cada eixo)
+#define DR_LEVELS 16
+
+// Controla a resolução interna para que a rasterização caiba em budget_ms. A resolução varia entre
+// min e max (a máxima do r_init), começando em start; todas são arredondadas para o nível mais próximo
+bool dr_init(uint16_t max_w, uint16_t max_h, uint16_t min_w, uint16_t start_w, float budget_ms);
+// Recebe o tempo do último frame; true se a resolução mudou (aplicar com r_set_resolution antes do próximo)
+bool dr_update(double frame_ms);
+bool dr_is_enabled();
+uint16_t dr_get_width();
+uint16_t dr_get_height();
+
+#endif
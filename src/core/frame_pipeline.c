@@ -0,0 +1,149 @@
+#include "frame_pipeline.h"
+#include <SDL2/SDL.h>
+#include "renderer/renderer.h"
+#include "logger.h"
+
+typedef struct _frame_pipeline
+{
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    fp_raster_func_t raster_func;
+    uint8_t depth;
+    bool quit;
+
+    // O frame k usa o slot (e o framebuffer) k % depth
+    frame_packet_t slots[FP_MAX_DEPTH];
+    uint32_t submitted, rasterized, presented;
+} frame_pipeline_t;
+
+static frame_pipeline_t pipeline = {0};
+
+static int fp_raster_worker(void *data)
+{
+    (void)data;
+
+    SDL_LockMutex(pipeline.lock);
+    while (true)
+    {
+        while (!pipeline.quit && pipeline.rasterized == pipeline.submitted)
+            SDL_CondWait(pipeline.cond, pipeline.lock);
+
+        if (pipeline.quit)
+            break;
+
+        uint8_t slot = pipeline.rasterized % pipeline.depth;
+        SDL_UnlockMutex(pipeline.lock);
+
+        r_set_draw_buffer(slot);
+        pipeline.raster_func(&pipeline.slots[slot]);
+
+        SDL_LockMutex(pipeline.lock);
+        pipeline.rasterized++;
+        SDL_CondBroadcast(pipeline.cond);
+    }
+    SDL_UnlockMutex(pipeline.lock);
+
+    return 0;
+}
+
+bool fp_init(uint8_t depth, fp_raster_func_t raster_func)
+{
+    if (depth < FP_MIN_DEPTH) depth = FP_MIN_DEPTH;
+    if (depth > FP_MAX_DEPTH) depth = FP_MAX_DEPTH;
+
+    pipeline = (frame_pipeline_t){0};
+    pipeline.raster_func = raster_func;
+    pipeline.depth = depth;
+
+    // Sem thread ou sem framebuffers suficientes, fp_submit desenha e apresenta na hora
+    if (!r_set_frame_buffer_count(depth))
+    {
+        pipeline.depth = 1;
+        return false;
+    }
+
+    pipeline.lock = SDL_CreateMutex();
+    pipeline.cond = SDL_CreateCond();
+    if (pipeline.lock != NULL && pipeline.cond != NULL)
+        pipeline.thread = SDL_CreateThread(fp_raster_worker, "doom_raster", NULL);
+
+    if (pipeline.thread == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel criar o thread de rasterizacao, os frames serao desenhados em serie");
+        return false;
+    }
+
+    DOOM_LOG_INFO("Pipeline de frames com profundidade %u", depth);
+    return true;
+}
+
+static void fp_present_oldest()
+{
+    SDL_LockMutex(pipeline.lock);
+    while (pipeline.rasterized == pipeline.presented)
+        SDL_CondWait(pipeline.cond, pipeline.lock);
+    uint8_t slot = pipeline.presented % pipeline.depth;
+    SDL_UnlockMutex(pipeline.lock);
+
+    r_present(slot);
+
+    // Só agora o slot pode receber outro frame
+    SDL_LockMutex(pipeline.lock);
+    pipeline.presented++;
+    SDL_UnlockMutex(pipeline.lock);
+}
+
+void fp_submit(const frame_packet_t *frame)
+{
+    if (pipeline.thread == NULL)
+    {
+        r_set_draw_buffer(0);
+        pipeline.raster_func(frame);
+        r_present(0);
+        return;
+    }
+
+    // O slot do próximo frame está livre: depois de cada envio ficam no máximo depth - 1 frames pendentes
+    pipeline.slots[pipeline.submitted % pipeline.depth] = *frame;
+
+    SDL_LockMutex(pipeline.lock);
+    pipeline.submitted++;
+    SDL_CondBroadcast(pipeline.cond);
+    SDL_UnlockMutex(pipeline.lock);
+
+    while (pipeline.submitted - pipeline.presented >= pipeline.depth)
+        fp_present_oldest();
+}
+
+void fp_flush()
+{
+    if (pipeline.thread == NULL) return;
+
+    while (pipeline.presented != pipeline.submitted)
+        fp_present_oldest();
+}
+
+uint8_t fp_get_depth()
+{
+    return pipeline.depth;
+}
+
+void fp_shutdown()
+{
+    fp_flush();
+
+    if (pipeline.thread != NULL)
+    {
+        SDL_LockMutex(pipeline.lock);
+        pipeline.quit = true;
+        SDL_CondBroadcast(pipeline.cond);
+        SDL_UnlockMutex(pipeline.lock);
+        SDL_WaitThread(pipeline.thread, NULL);
+    }
+
+    if (pipeline.lock != NULL) SDL_DestroyMutex(pipeline.lock);
+    if (pipeline.cond != NULL) SDL_DestroyCond(pipeline.cond);
+
+    pipeline = (frame_pipeline_t){0};
+}
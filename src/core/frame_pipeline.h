@@ -0,0 +1,38 @@
+#ifndef FRAME_PIPELINE_H_INCLUDED
+#define FRAME_PIPELINE_H_INCLUDED
+
+#include "typedefs.h"
+#include "player.h"
+#include "bsp/bsp.h"
+#include "assets/animation.h"
+
+#define FP_MIN_DEPTH 1
+#define FP_MAX_DEPTH 3
+
+// Tudo que a rasterização de um frame precisa, copiado do estado da simulação no fim do tick
+typedef struct _frame_packet
+{
+    bsp_t *bsp;
+    player_t player;
+    vec3f_t camera_position; // Posição do jogador com o balanço da câmera
+    animation_t weapon;
+    float normalized_velocity;
+    double time;
+    uint64_t animation_tick;
+    uint8_t gamma_level; // Aplicada no thread de rasterização, que é quem usa as tabelas de cor
+} frame_packet_t;
+
+// Desenha o frame no framebuffer atual; roda no thread de rasterização
+typedef void (*fp_raster_func_t)(const frame_packet_t *frame);
+
+// Simulação e apresentação ficam no thread principal (o do SDL) e a rasterização num thread próprio.
+// depth é o número de frames em andamento: 1 apresenta cada frame antes de simular o próximo (menor latência);
+// 2 apresenta o frame N enquanto o N + 1 é desenhado e o N + 2 simulado; 3 deixa mais um frame na fila
+bool fp_init(uint8_t depth, fp_raster_func_t raster_func);
+void fp_submit(const frame_packet_t *frame);
+// Apresenta todos os frames pendentes; necessário antes de liberar algo que eles referenciam (ex: o bsp)
+void fp_flush();
+uint8_t fp_get_depth();
+void fp_shutdown();
+
+#endif
@@ -8,11 +8,18 @@
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_keyboard.h"
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
 #include "utils.h"
 #include "assets/asset.h"
 #include "assets/image.h"
 #include "assets/animation.h"
 #include "timer.h"
+#include "jobs.h"
+#include "level_loader.h"
+#include "frame_pipeline.h"
+#include "dynamic_resolution.h"
 #include "fpga/device.h"
 
 #define PLAYER_ACCEL 10
@@ -26,11 +33,21 @@
 
 #define CAMERA_BOB_SPEED 10.f
 #define CAMERA_BOB_RANGE 5.f
+#define DEFAULT_FRAME_DEPTH 2
+
+#define TIMEDEMO_MAX_WAYPOINTS 64
+#define TIMEDEMO_FPS 35.f
+#define THING_NOT_SINGLE 0x10
+
+#define GOLDEN_MAX_VIEWS 256
+#define GOLDEN_THING_VIEWS 8
+#define GOLDEN_REPETITIONS 9
+#define GOLDEN_MIN_REGRESSION_MS 0.05
 
 
 typedef struct _game_core
 {
-    bool is_running, is_paused;
+    bool is_running, is_paused, headless;
     uint16_t scrnw, scrnh;
     player_t player;
 } game_core_t;
@@ -61,18 +78,105 @@ bool g_init(uint16_t scrn_w, uint16_t scrn_h)
     if (!w_init(scrn_w, scrn_h))
         return false;
 
-    if (!r_init(scrn_w / 4, scrn_h / 4))
+    if (!j_init(0))
+        return false;
+
+    // Com DOOM_FRAME_BUDGET (ms de rasterização, ex: 8) a resolução interna varia entre metade e o dobro
+    // da padrão (1/4 da janela); a máxima é reservada no r_init e o frame começa na padrão
+    const char *frame_budget = getenv("DOOM_FRAME_BUDGET");
+    if (frame_budget != NULL)
+    {
+        if (!r_init(scrn_w / 2, scrn_h / 2))
+            return false;
+        if (dr_init(scrn_w / 2, scrn_h / 2, scrn_w / 8, scrn_w / 4, atof(frame_budget)))
+            r_set_resolution(dr_get_width(), dr_get_height());
+        else
+            r_set_resolution(scrn_w / 4, scrn_h / 4);
+    }
+    else if (!r_init(scrn_w / 4, scrn_h / 4))
         return false;
 
+    // Uma faixa da tela por thread do pool
+    r_set_strip_count(j_get_thread_count());
+
     d_init();
 
     return true;
 }
 
+bool g_init_headless(uint16_t width, uint16_t height)
+{
+    game_manager.headless = true;
+
+    if (!j_init(0))
+        return false;
+
+    if (!r_init_headless(width, height))
+        return false;
+
+    r_set_strip_count(j_get_thread_count());
+    return true;
+}
+
+static void g_spawn_player(bsp_t *bsp)
+{
+    vec3f_t spawn = bsp_get_player_spawn(bsp);
+    game_manager.player.position.x = spawn.x;
+    game_manager.player.position.y = spawn.y;
+    game_manager.player.position.z = spawn.z + PLAYER_HEIGHT;
+    game_manager.player.angle = (bsp->entities[0].angle * PI) / 180.f;
+    game_manager.player.velocity = (vec3f_t){ 0, 0, 0 };
+}
+
+// E1M1 -> E1M2 ... E1M9; false quando não há próximo mapa no episódio
+static bool g_get_next_level_name(const char *level_name, char *next_name)
+{
+    if (strlen(level_name) != 4 || level_name[0] != 'E' || level_name[2] != 'M' || level_name[3] < '1' || level_name[3] >= '9')
+        return false;
+
+    memcpy(next_name, level_name, 5);
+    next_name[3]++;
+    return true;
+}
+
+// Roda no thread de rasterização, só com o que foi copiado para o frame
+static void g_rasterize_frame(const frame_packet_t *frame)
+{
+    uint64_t start = t_get_counter();
+    r_set_gamma(frame->gamma_level);
+    r_begin_draw(&frame->player);
+    bsp_update(frame->bsp, frame->camera_position, frame->player.angle);
+    bsp_render(frame->bsp);
+    bsp_render_sprites(frame->bsp, frame->animation_tick);
+    anm_render(&frame->weapon, frame->normalized_velocity, bsp_get_sub_sector_light(frame->bsp), frame->time);
+
+    // Entre um frame e outro, no mesmo thread: este já guardou o próprio tamanho para a apresentação
+    if (dr_update(t_get_elapsed_ms(start)))
+        r_set_resolution(dr_get_width(), dr_get_height());
+}
+
 void g_run()
 {
     wad_reader_t wad_reader = wdr_open("resources/DOOM1.WAD");
-    bsp_t bsp = bsp_create(&wad_reader, "E1M1");
+    if (wad_reader.directories == NULL)
+    {
+        fprintf(stderr, "Nao foi possivel abrir resources/DOOM1.WAD\n");
+        return;
+    }
+
+    // Orçamento opcional de memória para texturas (ex: DOOM_TEXTURE_BUDGET=16M)
+    const char *budget = getenv("DOOM_TEXTURE_BUDGET");
+    if (budget != NULL)
+        a_set_residency_budget(u_parse_size(budget));
+
+    // Os assets precisam existir antes do nível para que ele possa referenciar suas texturas
+    a_init(&wad_reader, "resources/DOOM1.cache");
+    char level_name[9] = "E1M1", next_level_name[9];
+    bsp_t bsp = bsp_create(&wad_reader, level_name);
+
+    // O próximo mapa é montado em segundo plano enquanto este roda
+    if (g_get_next_level_name(level_name, next_level_name))
+        lv_request(&wad_reader, next_level_name);
 
     typedef struct _mus
     {
@@ -95,20 +199,23 @@ void g_run()
         mus.num_instruments);
     }
 
-    a_init(&wad_reader);
-    
-    wdr_close(&wad_reader);
+    g_spawn_player(&bsp);
 
-    vec3f_t spawn = bsp_get_player_spawn(&bsp);
-    game_manager.player.position.x = spawn.x;
-    game_manager.player.position.y = spawn.y;
-    game_manager.player.position.z = spawn.z + PLAYER_HEIGHT;
-    game_manager.player.angle = (bsp.entities[0].angle * PI) / 180.f;
+    // Profundidade do pipeline de frames (ex: DOOM_FRAME_DEPTH=1 para a menor latência)
+    const char *depth = getenv("DOOM_FRAME_DEPTH");
+    fp_init(depth != NULL ? atoi(depth) : DEFAULT_FRAME_DEPTH, g_rasterize_frame);
+
+    // DOOM_WALLS=float desenha as paredes pelo caminho antigo, para comparar com o de ponto fixo
+    const char *walls = getenv("DOOM_WALLS");
+    r_set_fixed_point_walls(walls == NULL || strcmp(walls, "float") != 0);
 
     const uint8_t* keystate = SDL_GetKeyboardState(NULL);
     float sense = 0.2f;
 
     bool esc_pressed = false;
+    bool gamma_pressed = false;
+    uint8_t gamma_level = 0;
+    bool next_level_pressed = false, change_level = false;
     animation_t pistol_anim = anm_create_animation(SHOTGUN_INDEX, SHOTGUN_COUNT, false, SHOTGUN);
     int16_t last_ground_height = 0;
 
@@ -118,6 +225,51 @@ void g_run()
         t_update();
         double delta_time = t_get_delta_time();
 
+        if (keystate[SDL_SCANCODE_N])
+        {
+            if (!next_level_pressed)
+                change_level = true;
+            next_level_pressed = true;
+        }
+        else
+            next_level_pressed = false;
+
+        // A troca acontece só no início do tick e fica pendente enquanto o nível seguinte carrega; pronto,
+        // é só trocar o bsp. Se o carregamento falhou, o nível atual continua
+        level_load_state_t load_state = lv_get_state();
+        if (change_level && load_state != LV_LOADING)
+        {
+            change_level = false;
+            bsp_t next_bsp;
+            if (load_state == LV_FAILED)
+            {
+                DOOM_LOG_ERROR("Nivel %s nao foi carregado, continuando em %s", lv_get_level_name(), level_name);
+            }
+            else if (lv_take(&next_bsp))
+            {
+                uint64_t start = t_get_counter();
+                (void)start;
+
+                // Frames ainda em andamento desenham o nível antigo
+                fp_flush();
+                bsp_t old_bsp = bsp;
+                bsp = next_bsp;
+                bsp_delete(&old_bsp);
+
+                strcpy(level_name, lv_get_level_name());
+                g_spawn_player(&bsp);
+                last_ground_height = (int16_t)(game_manager.player.position.z - PLAYER_HEIGHT);
+                DOOM_LOG_INFO("Nivel %s ativado em %.3f ms", level_name, t_get_elapsed_ms(start));
+
+                if (g_get_next_level_name(level_name, next_level_name))
+                    lv_request(&wad_reader, next_level_name);
+            }
+            else
+            {
+                DOOM_LOG_WARN("Nenhum nivel seguinte disponivel");
+            }
+        }
+
         if(keystate[SDL_SCANCODE_ESCAPE] || (d_switch_read() & 0x01) != 0) 
         {
             if (!esc_pressed)
@@ -126,6 +278,16 @@ void g_run()
         }
         else
             esc_pressed = false;
+
+        // F11 alterna a gama como no Doom; só as tabelas de 256 cores são refeitas
+        if (keystate[SDL_SCANCODE_F11])
+        {
+            if (!gamma_pressed)
+                gamma_level = (gamma_level + 1) % GAMMA_LEVELS;
+            gamma_pressed = true;
+        }
+        else
+            gamma_pressed = false;
         
         if (!game_manager.is_paused)
         {
@@ -191,9 +353,8 @@ void g_run()
             game_manager.player.position.x += game_manager.player.velocity.x * delta_time;
             game_manager.player.position.y += game_manager.player.velocity.y * delta_time;
     
-            // Atualiza para obter a altura do subsetor
-            bsp_update(&bsp, game_manager.player.position, game_manager.player.angle);
-            int16_t new_ground_height = bsp_get_sub_sector_height(&bsp);
+            // Altura do subsetor sob o jogador; a câmera do bsp pertence ao thread de rasterização
+            int16_t new_ground_height = bsp_get_sub_sector_height_for_ent(&bsp, (int16_t)game_manager.player.position.x, (int16_t)game_manager.player.position.y);
             float delta_z = new_ground_height + PLAYER_HEIGHT - game_manager.player.position.z;
             if (delta_z > 0)
             {
@@ -222,20 +383,21 @@ void g_run()
             }
             
             anm_update(&pistol_anim);
-            
-            r_begin_draw(&game_manager.player);
 
             float normalized_velocity = (u_magnitude_vec(game_manager.player.velocity.x, game_manager.player.velocity.y, 0)) / PLAYER_MAX_SPEED;
             float bob_y = (cos(t_get_time() * CAMERA_BOB_SPEED)) * CAMERA_BOB_RANGE * normalized_velocity;
 
-            vec3f_t tmp = game_manager.player.position;
-            tmp.z += bob_y;
-            // Atualiza novamente para renderizar com a nova altura + bob_y
-            bsp_update(&bsp, tmp, game_manager.player.angle);
-
-            bsp_render(&bsp);
-            bsp_render_sprites(&bsp);
-            anm_render(&pistol_anim, normalized_velocity);
+            frame_packet_t frame = {
+                .bsp = &bsp,
+                .player = game_manager.player,
+                .camera_position = game_manager.player.position,
+                .weapon = pistol_anim,
+                .normalized_velocity = normalized_velocity,
+                .time = t_get_time(),
+                .animation_tick = t_get_animation_tick(),
+                .gamma_level = gamma_level
+            };
+            frame.camera_position.z += bob_y;
 
             // Troca para a mão quando acaba a bala
             if (game_manager.player.weapon_index != 0 && game_manager.player.bullet_count[game_manager.player.weapon_index] == 0 && !pistol_anim.is_playing)
@@ -244,17 +406,454 @@ void g_run()
                 pistol_anim = anm_create_animation(FIST_INDEX, FIST_COUNT, false, FIST);
             }
 
+            fp_submit(&frame);
+        }
+    }
+
+    fp_shutdown();
+    lv_shutdown();
+    bsp_delete(&bsp);
+    a_shutdown();
+    wdr_close(&wad_reader);
+}
+
+// Caminho padrão do -timedemo: o início do jogador seguido das coisas do modo single player, na ordem do
+// lump. Depende só do WAD, então toda execução desenha as mesmas vistas
+static uint32_t g_build_timedemo_path(const bsp_t *bsp, vec2f_t *waypoints)
+{
+    uint32_t count = 0;
+    for (int16_t i = 0; i < bsp->entities_count && count < TIMEDEMO_MAX_WAYPOINTS; i++)
+    {
+        const entity_t *ent = &bsp->entities[i];
+        if (i > 0 && (ent->flags & THING_NOT_SINGLE) != 0) continue;
+
+        vec2f_t point = { ent->pos_x, ent->pos_y };
+        if (count > 0 && point.x == waypoints[count - 1].x && point.y == waypoints[count - 1].y) continue;
+
+        waypoints[count++] = point;
+    }
+
+    return count;
+}
+
+static uint32_t g_load_timedemo_path(const char *path, vec2f_t *waypoints)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+
+    uint32_t count = 0;
+    while (count < TIMEDEMO_MAX_WAYPOINTS && fscanf(file, "%f %f", &waypoints[count].x, &waypoints[count].y) == 2)
+        count++;
+
+    fclose(file);
+    return count;
+}
+
+// Catmull-Rom entre p1 e p2; a tangente dá a direção da câmera
+static vec2f_t g_catmull_rom(const vec2f_t *p, float t, vec2f_t *tangent)
+{
+    vec2f_t a = { 2 * p[1].x, 2 * p[1].y };
+    vec2f_t b = { p[2].x - p[0].x, p[2].y - p[0].y };
+    vec2f_t c = { 2 * p[0].x - 5 * p[1].x + 4 * p[2].x - p[3].x, 2 * p[0].y - 5 * p[1].y + 4 * p[2].y - p[3].y };
+    vec2f_t d = { -p[0].x + 3 * p[1].x - 3 * p[2].x + p[3].x, -p[0].y + 3 * p[1].y - 3 * p[2].y + p[3].y };
+
+    *tangent = (vec2f_t) { 0.5f * (b.x + 2 * c.x * t + 3 * d.x * t * t), 0.5f * (b.y + 2 * c.y * t + 3 * d.y * t * t) };
+    return (vec2f_t) { 0.5f * (a.x + b.x * t + c.x * t * t + d.x * t * t * t), 0.5f * (a.y + b.y * t + c.y * t * t + d.y * t * t * t) };
+}
+
+// Posição e ângulo da câmera no frame i de frame_count, com velocidade constante por trecho do caminho
+static void g_sample_timedemo_path(const vec2f_t *waypoints, uint32_t count, uint32_t i, uint32_t frame_count, player_t *player)
+{
+    // Um ponto só: a câmera gira no lugar
+    if (count == 1)
+    {
+        player->position.x = waypoints[0].x;
+        player->position.y = waypoints[0].y;
+        player->angle = 2 * PI * i / frame_count;
+        return;
+    }
+
+    float u = (float)i * (count - 1) / frame_count;
+    uint32_t segment = (uint32_t)u;
+    if (segment >= count - 1) segment = count - 2;
+
+    vec2f_t p[4] = {
+        waypoints[segment > 0 ? segment - 1 : 0],
+        waypoints[segment],
+        waypoints[segment + 1],
+        waypoints[segment + 2 < count ? segment + 2 : count - 1]
+    };
+
+    vec2f_t tangent;
+    vec2f_t position = g_catmull_rom(p, u - segment, &tangent);
+    player->position.x = position.x;
+    player->position.y = position.y;
+
+    // Parado (pontos repetidos) mantém o ângulo anterior
+    if (fabsf(tangent.x) + fabsf(tangent.y) > 1e-3f)
+    {
+        player->angle = atan2f(tangent.y, tangent.x);
+        if (player->angle < 0)
+            player->angle += 2 * PI;
+    }
+}
+
+static int g_compare_ms(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// Percentil pelo método do posto mais próximo; samples precisa estar ordenado
+static double g_percentile(const double *samples, uint32_t count, double p)
+{
+    uint32_t rank = (uint32_t)ceil(p * count);
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+static bool g_write_timedemo_json(const timedemo_options_t *options, uint32_t waypoint_count, double *frame_ms)
+{
+    FILE *file = options->json_path != NULL ? fopen(options->json_path, "w") : stdout;
+    if (file == NULL)
+        return false;
+
+    uint32_t count = options->frame_count;
+    double total = 0;
+    for (uint32_t i = 0; i < count; i++)
+        total += frame_ms[i];
+
+    qsort(frame_ms, count, sizeof(double), g_compare_ms);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"map\": \"%s\",\n", options->level_name);
+    fprintf(file, "  \"width\": %u,\n  \"height\": %u,\n", r_get_width(), r_get_height());
+    fprintf(file, "  \"strips\": %u,\n  \"threads\": %u,\n", r_get_strip_count(), j_get_thread_count());
+    fprintf(file, "  \"waypoints\": %u,\n  \"frames\": %u,\n", waypoint_count, count);
+    fprintf(file, "  \"total_ms\": %.3f,\n", total);
+    fprintf(file, "  \"avg_fps\": %.2f,\n", total > 0 ? count * 1000.0 / total : 0.0);
+    fprintf(file, "  \"frame_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }\n",
+        total / count, g_percentile(frame_ms, count, 0.50), g_percentile(frame_ms, count, 0.95),
+        g_percentile(frame_ms, count, 0.99), frame_ms[count - 1]);
+    fprintf(file, "}\n");
+
+    bool written = !ferror(file);
+    if (file != stdout && fclose(file) != 0)
+        written = false;
+
+    return written;
+}
+
+bool g_run_timedemo(const timedemo_options_t *options)
+{
+    if (options->frame_count == 0)
+        return false;
+
+    wad_reader_t wad_reader = wdr_open(options->wad_path);
+    if (wad_reader.directories == NULL)
+    {
+        fprintf(stderr, "Nao foi possivel abrir %s\n", options->wad_path);
+        return false;
+    }
+
+    a_init(&wad_reader, NULL);
+    bsp_t bsp = bsp_create(&wad_reader, options->level_name);
+    double *frame_ms = malloc(options->frame_count * sizeof(double));
+    vec2f_t waypoints[TIMEDEMO_MAX_WAYPOINTS];
+    uint32_t waypoint_count = 0;
+    bool success = false;
+
+    if (bsp.nodes == NULL)
+        fprintf(stderr, "Mapa %s nao encontrado\n", options->level_name);
+    else
+    {
+        waypoint_count = options->path_file != NULL ? g_load_timedemo_path(options->path_file, waypoints)
+                                                    : g_build_timedemo_path(&bsp, waypoints);
+        if (waypoint_count == 0)
+            fprintf(stderr, "Caminho do timedemo vazio\n");
+    }
+
+    if (frame_ms != NULL && waypoint_count > 0)
+    {
+        // O tempo da demo anda um tick por frame, independente do relógio: as animações também se repetem
+        player_t player = { .angle = (bsp.entities[0].angle * PI) / 180.f };
+        frame_packet_t frame = {
+            .bsp = &bsp,
+            .weapon = anm_create_animation(SHOTGUN_INDEX, SHOTGUN_COUNT, false, SHOTGUN),
+            .normalized_velocity = 0
+        };
+
+        // O frame 0 é de aquecimento (arena do frame e texturas chegam ao tamanho final) e não entra na conta
+        for (uint32_t i = 0; i <= options->frame_count; i++)
+        {
+            g_sample_timedemo_path(waypoints, waypoint_count, i > 0 ? i - 1 : 0, options->frame_count, &player);
+            player.position.z = bsp_get_sub_sector_height_for_ent(&bsp, (int16_t)player.position.x, (int16_t)player.position.y) + PLAYER_HEIGHT;
+
+            frame.player = player;
+            frame.camera_position = player.position;
+            frame.time = i / TIMEDEMO_FPS;
+            frame.animation_tick = (uint64_t)(frame.time / ANIMATION_TICK);
+
+            uint64_t start = t_get_counter();
+            g_rasterize_frame(&frame);
             r_end_draw();
+            if (i > 0)
+                frame_ms[i - 1] = t_get_elapsed_ms(start);
+        }
+
+        success = g_write_timedemo_json(options, waypoint_count, frame_ms);
+        if (!success)
+            fprintf(stderr, "Nao foi possivel gravar o resultado do timedemo\n");
+    }
+
+    free(frame_ms);
+    bsp_delete(&bsp);
+    a_shutdown();
+    wdr_close(&wad_reader);
+    return success;
+}
+
+// Vista do golden: posição e ângulo (em graus) da câmera, com o hash da imagem e o tempo de referência
+typedef struct _golden_view
+{
+    char level_name[9];
+    float x, y, angle;
+    uint64_t hash;
+    double ms;
+} golden_view_t;
+
+// Vistas padrão de um mapa: o início do jogador nos quatro sentidos e as primeiras coisas do modo single
+// player, cada uma olhando para o seu ângulo
+static uint32_t g_build_golden_views(const bsp_t *bsp, const char *level_name, golden_view_t *views, uint32_t max_views)
+{
+    uint32_t count = 0, things = 0;
+    for (int16_t i = 0; i < bsp->entities_count && count < max_views; i++)
+    {
+        const entity_t *ent = &bsp->entities[i];
+        if (i > 0 && ((ent->flags & THING_NOT_SINGLE) != 0 || things++ >= GOLDEN_THING_VIEWS)) continue;
+
+        for (uint16_t turn = 0; turn < (i == 0 ? 4 : 1) && count < max_views; turn++)
+        {
+            golden_view_t *view = &views[count++];
+            *view = (golden_view_t) { .x = ent->pos_x, .y = ent->pos_y, .angle = fmodf(ent->angle + turn * 90.f, 360.f) };
+            strncpy(view->level_name, level_name, sizeof(view->level_name) - 1);
+        }
+    }
+
+    return count;
+}
+
+// FNV-1a 64 das cores da imagem, sem o alfa: o hash é o mesmo com e sem o framebuffer de 8 bits
+static uint64_t g_hash_frame(const uint32_t *rgba, uint32_t count)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint8_t byte = 0; byte < 3; byte++)
+        {
+            hash ^= (rgba[i] >> (byte * 8)) & 0xFF;
+            hash *= 0x100000001b3ull;
+        }
+    }
+
+    return hash;
+}
+
+// Desenha a vista algumas vezes depois de um frame de aquecimento. O tempo é o menor de todos, o menos
+// sujeito a ruído da máquina
+static void g_render_golden_view(bsp_t *bsp, golden_view_t *view, uint32_t *rgba)
+{
+    player_t player = { .angle = view->angle * PI / 180.f };
+    player.position = (vec3f_t) { view->x, view->y, bsp_get_sub_sector_height_for_ent(bsp, (int16_t)view->x, (int16_t)view->y) + PLAYER_HEIGHT };
+
+    frame_packet_t frame = {
+        .bsp = bsp,
+        .player = player,
+        .camera_position = player.position,
+        .weapon = anm_create_animation(SHOTGUN_INDEX, SHOTGUN_COUNT, false, SHOTGUN),
+    };
+
+    double samples[GOLDEN_REPETITIONS];
+    for (int32_t i = -1; i < GOLDEN_REPETITIONS; i++)
+    {
+        uint64_t start = t_get_counter();
+        g_rasterize_frame(&frame);
+        r_end_draw();
+        if (i >= 0)
+            samples[i] = t_get_elapsed_ms(start);
+    }
+
+    qsort(samples, GOLDEN_REPETITIONS, sizeof(double), g_compare_ms);
+    view->ms = samples[0];
+
+    r_read_frame(rgba);
+    view->hash = g_hash_frame(rgba, r_get_width() * r_get_height());
+}
+
+static uint32_t g_read_golden(const char *path, golden_view_t *views)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+
+    unsigned width = 0, height = 0;
+    char line[256];
+    uint32_t count = 0;
+    while (count < GOLDEN_MAX_VIEWS && fgets(line, sizeof(line), file) != NULL)
+    {
+        golden_view_t *view = &views[count];
+        unsigned long long hash;
+
+        if (line[0] == '#') continue;
+        if (sscanf(line, "size %u %u", &width, &height) == 2) continue;
+        if (sscanf(line, "%8s %f %f %f %llx %lf", view->level_name, &view->x, &view->y, &view->angle, &hash, &view->ms) == 6)
+        {
+            view->hash = hash;
+            count++;
+        }
+    }
+
+    fclose(file);
+
+    // Os hashes só valem na resolução em que foram gravados
+    if (width != r_get_width() || height != r_get_height())
+    {
+        fprintf(stderr, "%s foi gravado em %ux%u, o renderer esta em %ux%u\n", path, width, height, r_get_width(), r_get_height());
+        return 0;
+    }
+
+    return count;
+}
+
+static bool g_write_golden(const char *path, const golden_view_t *views, uint32_t count)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "# mapa x y angulo hash ms\n");
+    fprintf(file, "size %u %u\n", r_get_width(), r_get_height());
+    for (uint32_t i = 0; i < count; i++)
+        fprintf(file, "%s %.1f %.1f %.1f %016llx %.4f\n", views[i].level_name, views[i].x, views[i].y, views[i].angle,
+            (unsigned long long)views[i].hash, views[i].ms);
+
+    return fclose(file) == 0;
+}
+
+// Lista de mapas do -golden -update; os que não estão no WAD são ignorados
+static uint32_t g_build_golden_map_views(wad_reader_t *wad_reader, const char *maps, golden_view_t *views)
+{
+    char list[256];
+    strncpy(list, maps, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+
+    uint32_t count = 0;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        bsp_t bsp = bsp_create(wad_reader, name);
+        if (bsp.nodes == NULL)
+        {
+            fprintf(stderr, "Mapa %s nao encontrado\n", name);
+            continue;
+        }
+
+        count += g_build_golden_views(&bsp, name, &views[count], GOLDEN_MAX_VIEWS - count);
+        bsp_delete(&bsp);
+    }
+
+    return count;
+}
+
+int g_run_golden(const golden_options_t *options)
+{
+    wad_reader_t wad_reader = wdr_open(options->wad_path);
+    if (wad_reader.directories == NULL)
+    {
+        fprintf(stderr, "Nao foi possivel abrir %s\n", options->wad_path);
+        return 1;
+    }
+
+    a_init(&wad_reader, NULL);
+
+    golden_view_t *views = malloc(GOLDEN_MAX_VIEWS * sizeof(golden_view_t));
+    uint32_t *rgba = malloc(r_get_width() * r_get_height() * sizeof(uint32_t));
+    uint32_t count = 0;
+    if (views != NULL && rgba != NULL)
+        count = options->update ? g_build_golden_map_views(&wad_reader, options->maps, views) : g_read_golden(options->golden_path, views);
+
+    if (count == 0)
+        fprintf(stderr, "Nenhuma vista para desenhar\n");
+
+    uint32_t changed = 0, slower = 0;
+    bsp_t bsp = {0};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        golden_view_t *view = &views[i];
+
+        // As vistas de um mapa ficam juntas: o nível só é trocado quando o mapa muda
+        if (i == 0 || strcmp(view->level_name, views[i - 1].level_name) != 0)
+        {
+            bsp_delete(&bsp);
+            bsp = bsp_create(&wad_reader, view->level_name);
+        }
+
+        if (bsp.nodes == NULL)
+        {
+            printf("%-5s #%-3u sem mapa\n", view->level_name, i);
+            changed++;
+            continue;
+        }
+
+        golden_view_t expected = *view;
+        g_render_golden_view(&bsp, view, rgba);
+        if (options->update)
+        {
+            printf("%-5s #%-3u %016llx %8.4f ms\n", view->level_name, i, (unsigned long long)view->hash, view->ms);
+            continue;
+        }
+
+        bool same_image = view->hash == expected.hash;
+        bool regressed = view->ms > expected.ms * (1 + options->threshold) && view->ms - expected.ms > GOLDEN_MIN_REGRESSION_MS;
+        changed += !same_image;
+        slower += regressed;
+
+        printf("%-5s #%-3u %-10s %8.4f ms (ref %.4f, %+.1f%%)\n", view->level_name, i,
+            !same_image ? "DIFERENTE" : (regressed ? "LENTA" : "ok"), view->ms, expected.ms,
+            expected.ms > 0 ? (view->ms / expected.ms - 1) * 100 : 0.0);
+
+        // A imagem nova fica ao lado do golden para comparar
+        if (!same_image)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s.%u.ppm", options->golden_path, i);
+            r_write_ppm(path);
         }
     }
 
     bsp_delete(&bsp);
+
+    int status = count == 0 || changed > 0 ? 1 : (slower > 0 ? 2 : 0);
+    if (options->update && status == 0 && !g_write_golden(options->golden_path, views, count))
+    {
+        fprintf(stderr, "Nao foi possivel gravar %s\n", options->golden_path);
+        status = 1;
+    }
+    else if (!options->update && count > 0)
+        printf("%u vistas, %u diferentes, %u mais lentas que %.0f%%\n", count, changed, slower, options->threshold * 100);
+
+    free(views);
+    free(rgba);
     a_shutdown();
+    wdr_close(&wad_reader);
+    return status;
 }
 
 void g_shutdown()
 {
-    d_shutdown();
+    j_shutdown();
+    if (!game_manager.headless)
+        d_shutdown();
     r_shutdown();
-    w_shutdown();
+    if (!game_manager.headless)
+        w_shutdown();
 }
@@ -3,8 +3,32 @@
 
 #include "typedefs.h"
 
+// Opções do -timedemo; path_file é opcional (uma linha "x y" por ponto do caminho)
+typedef struct _timedemo_options
+{
+    const char *wad_path, *level_name, *path_file, *json_path;
+    uint16_t width, height;
+    uint32_t frame_count;
+} timedemo_options_t;
+
+// Opções do -golden. Com update o arquivo é regravado com as vistas padrão dos mapas de maps (lista separada
+// por vírgula); sem ele as vistas do arquivo são desenhadas e comparadas
+typedef struct _golden_options
+{
+    const char *wad_path, *golden_path, *maps;
+    float threshold; // Aumento relativo de tempo a partir do qual a vista é marcada como regressão
+    bool update;
+} golden_options_t;
+
 bool g_init(uint16_t scrn_w, uint16_t scrn_h);
+// Sem janela nem dispositivo: só o pool de threads e o renderer, na resolução interna dada
+bool g_init_headless(uint16_t width, uint16_t height);
 void g_run();
+// Percorre o mapa num caminho fixo, desenhando o mais rápido possível, e grava os tempos de frame em JSON
+bool g_run_timedemo(const timedemo_options_t *options);
+// Confere o hash e o tempo de cada vista com o arquivo golden. Retorna 0 se tudo bate, 1 se alguma imagem
+// mudou (ou em erro) e 2 se só o tempo piorou
+int g_run_golden(const golden_options_t *options);
 void g_shutdown();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "jobs.h"
+#include <SDL2/SDL.h>
+#include "logger.h"
+
+#define MAX_WORKERS 64
+
+typedef struct _job_pool
+{
+    SDL_Thread *workers[MAX_WORKERS];
+    uint32_t worker_count;
+    SDL_mutex *lock, *submit_lock;
+    SDL_cond *work_cond, *done_cond;
+
+    // Lote atual
+    job_func_t func;
+    void *ctx;
+    uint32_t count;
+    uint64_t generation;
+    uint32_t active_workers; // workers ainda dentro de um lote
+    SDL_atomic_t next_index, done_count;
+    bool quit;
+} job_pool_t;
+
+static job_pool_t pool = {0};
+
+// Workers (e o thread que está executando um lote) não podem abrir outro lote
+static __thread bool inside_job = false;
+
+static void j_run_batch(job_func_t func, void *ctx, uint32_t count)
+{
+    bool was_inside = inside_job;
+    inside_job = true;
+
+    uint32_t done = 0;
+    while (true)
+    {
+        uint32_t index = (uint32_t)SDL_AtomicAdd(&pool.next_index, 1);
+        if (index >= count) break;
+
+        func(ctx, index);
+        done++;
+    }
+
+    inside_job = was_inside;
+
+    if (done > 0)
+        SDL_AtomicAdd(&pool.done_count, done);
+}
+
+static int j_worker(void *data)
+{
+    (void)data;
+    uint64_t seen_generation = 0;
+
+    while (true)
+    {
+        SDL_LockMutex(pool.lock);
+        while (!pool.quit && pool.generation == seen_generation)
+            SDL_CondWait(pool.work_cond, pool.lock);
+
+        if (pool.quit)
+        {
+            SDL_UnlockMutex(pool.lock);
+            return 0;
+        }
+
+        seen_generation = pool.generation;
+        job_func_t func = pool.func;
+        void *ctx = pool.ctx;
+        uint32_t count = pool.count;
+        pool.active_workers++;
+        SDL_UnlockMutex(pool.lock);
+
+        j_run_batch(func, ctx, count);
+
+        SDL_LockMutex(pool.lock);
+        pool.active_workers--;
+        SDL_CondBroadcast(pool.done_cond);
+        SDL_UnlockMutex(pool.lock);
+    }
+}
+
+bool j_init(uint32_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = SDL_GetCPUCount();
+    if (thread_count > MAX_WORKERS + 1)
+        thread_count = MAX_WORKERS + 1;
+
+    pool = (job_pool_t){0};
+    pool.lock = SDL_CreateMutex();
+    pool.submit_lock = SDL_CreateMutex();
+    pool.work_cond = SDL_CreateCond();
+    pool.done_cond = SDL_CreateCond();
+
+    if (pool.lock == NULL || pool.submit_lock == NULL || pool.work_cond == NULL || pool.done_cond == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel criar o pool de threads");
+        j_shutdown();
+        return false;
+    }
+
+    // O thread que chama j_parallel_for também trabalha, então são criados thread_count - 1 workers
+    for (uint32_t i = 0; i + 1 < thread_count; i++)
+    {
+        pool.workers[i] = SDL_CreateThread(j_worker, "doom_worker", NULL);
+        if (pool.workers[i] == NULL)
+            break;
+        pool.worker_count++;
+    }
+
+    return true;
+}
+
+void j_parallel_for(uint32_t count, job_func_t func, void *ctx)
+{
+    if (count == 0) return;
+
+    // Sem workers (ou chamada aninhada): executa em série no thread atual
+    if (pool.worker_count == 0 || inside_job || count == 1)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            func(ctx, i);
+        return;
+    }
+
+    SDL_LockMutex(pool.submit_lock);
+
+    SDL_LockMutex(pool.lock);
+    // Um worker atrasado do lote anterior ainda pode estar lendo o contador
+    while (pool.active_workers > 0)
+        SDL_CondWait(pool.done_cond, pool.lock);
+
+    pool.func = func;
+    pool.ctx = ctx;
+    pool.count = count;
+    SDL_AtomicSet(&pool.next_index, 0);
+    SDL_AtomicSet(&pool.done_count, 0);
+    pool.generation++;
+    SDL_CondBroadcast(pool.work_cond);
+    SDL_UnlockMutex(pool.lock);
+
+    j_run_batch(func, ctx, count);
+
+    // Espera os itens pegos pelos workers terminarem
+    SDL_LockMutex(pool.lock);
+    while ((uint32_t)SDL_AtomicGet(&pool.done_count) < count)
+        SDL_CondWait(pool.done_cond, pool.lock);
+    SDL_UnlockMutex(pool.lock);
+
+    SDL_UnlockMutex(pool.submit_lock);
+}
+
+uint32_t j_get_thread_count()
+{
+    return pool.worker_count + 1;
+}
+
+void j_shutdown()
+{
+    if (pool.lock != NULL)
+    {
+        SDL_LockMutex(pool.lock);
+        pool.quit = true;
+        SDL_CondBroadcast(pool.work_cond);
+        SDL_UnlockMutex(pool.lock);
+    }
+
+    for (uint32_t i = 0; i < pool.worker_count; i++)
+        SDL_WaitThread(pool.workers[i], NULL);
+
+    if (pool.lock != NULL) SDL_DestroyMutex(pool.lock);
+    if (pool.submit_lock != NULL) SDL_DestroyMutex(pool.submit_lock);
+    if (pool.work_cond != NULL) SDL_DestroyCond(pool.work_cond);
+    if (pool.done_cond != NULL) SDL_DestroyCond(pool.done_cond);
+
+    pool = (job_pool_t){0};
+}
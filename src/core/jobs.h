@@ -0,0 +1,14 @@
+#ifndef JOBS_H_INCLUDED
+#define JOBS_H_INCLUDED
+
+#include "typedefs.h"
+
+// Função executada para cada índice de um j_parallel_for
+typedef void (*job_func_t)(void *ctx, uint32_t index);
+
+bool j_init(uint32_t thread_count);
+void j_parallel_for(uint32_t count, job_func_t func, void *ctx);
+uint32_t j_get_thread_count();
+void j_shutdown();
+
+#endif
@@ -0,0 +1,97 @@
+#include "level_loader.h"
+#include <SDL2/SDL.h>
+#include <string.h>
+#include "logger.h"
+#include "timer.h"
+
+typedef struct _level_loader
+{
+    SDL_Thread *thread;
+    SDL_atomic_t state;
+    wad_reader_t *wdr;
+    char level_name[9];
+    bsp_t bsp;
+} level_loader_t;
+
+static level_loader_t loader = {0};
+
+static int lv_worker(void *data)
+{
+    (void)data;
+    uint64_t start = t_get_counter();
+    (void)start; // Só o log lê, e ele some no release
+
+    loader.bsp = bsp_create(loader.wdr, loader.level_name);
+    bool loaded = loader.bsp.sector_flats != NULL;
+
+    if (loaded)
+    {
+        DOOM_LOG_INFO("Nivel %s pre-carregado em %.2f ms", loader.level_name, t_get_elapsed_ms(start));
+    }
+
+    // Publica o bsp só depois de pronto; lv_take lê o estado antes de tocar nele
+    SDL_AtomicSet(&loader.state, loaded ? LV_READY : LV_FAILED);
+    return 0;
+}
+
+static void lv_join()
+{
+    if (loader.thread != NULL)
+    {
+        SDL_WaitThread(loader.thread, NULL);
+        loader.thread = NULL;
+    }
+}
+
+bool lv_request(wad_reader_t *wdr, const char *level_name)
+{
+    if (SDL_AtomicGet(&loader.state) == LV_LOADING) return false;
+
+    // Um nível pronto e não usado é descartado
+    lv_join();
+    bsp_delete(&loader.bsp);
+
+    loader.wdr = wdr;
+    strncpy(loader.level_name, level_name, 8);
+    loader.level_name[8] = '\0';
+    SDL_AtomicSet(&loader.state, LV_LOADING);
+
+    loader.thread = SDL_CreateThread(lv_worker, "doom_level_loader", NULL);
+    if (loader.thread == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel criar o thread de carregamento do nivel %s", level_name);
+        SDL_AtomicSet(&loader.state, LV_IDLE);
+        return false;
+    }
+
+    return true;
+}
+
+level_load_state_t lv_get_state()
+{
+    return (level_load_state_t)SDL_AtomicGet(&loader.state);
+}
+
+const char *lv_get_level_name()
+{
+    return loader.level_name;
+}
+
+bool lv_take(bsp_t *out)
+{
+    if (SDL_AtomicGet(&loader.state) != LV_READY) return false;
+
+    lv_join();
+    *out = loader.bsp;
+    loader.bsp = (bsp_t){0};
+    SDL_AtomicSet(&loader.state, LV_IDLE);
+
+    return true;
+}
+
+void lv_shutdown()
+{
+    lv_join();
+    bsp_delete(&loader.bsp);
+    loader = (level_loader_t){0};
+}
@@ -0,0 +1,23 @@
+#ifndef LEVEL_LOADER_H_INCLUDED
+#define LEVEL_LOADER_H_INCLUDED
+
+#include "typedefs.h"
+#include "bsp/bsp.h"
+
+typedef enum _level_load_state
+{
+    LV_IDLE,
+    LV_LOADING,
+    LV_READY,
+    LV_FAILED,
+} level_load_state_t;
+
+// Monta um nível completo (bsp + texturas resolvidas) em um thread próprio enquanto o nível atual continua rodando
+bool lv_request(wad_reader_t *wdr, const char *level_name);
+level_load_state_t lv_get_state();
+const char *lv_get_level_name();
+// Se o nível pedido estiver pronto, transfere-o para out (a troca em si é só uma cópia da struct)
+bool lv_take(bsp_t *out);
+void lv_shutdown();
+
+#endif
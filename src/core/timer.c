@@ -52,3 +52,13 @@ uint64_t t_get_animation_tick()
 {
     return time_manager.animation_ticks;
 }
+
+uint64_t t_get_counter()
+{
+    return SDL_GetPerformanceCounter();
+}
+
+double t_get_elapsed_ms(uint64_t start_counter)
+{
+    return (double)(SDL_GetPerformanceCounter() - start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
@@ -11,5 +11,7 @@ double t_get_time();
 double t_get_delta_time();
 uint64_t t_get_tick();
 uint64_t t_get_animation_tick();
+uint64_t t_get_counter();
+double t_get_elapsed_ms(uint64_t start_counter);
 
 #endif
\ No newline at end of file
@@ -1,7 +1,87 @@
 #include "core/game_core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main()
+// -timedemo [ExMy] [-frames N] [-width N] [-height N] [-path arquivo] [-json arquivo] [-wad arquivo]
+static int timedemo_main(int argc, char **argv)
 {
+    timedemo_options_t options = {
+        .wad_path = "resources/DOOM1.WAD",
+        .level_name = "E1M1",
+        .width = 320,
+        .height = 240,
+        .frame_count = 2000,
+    };
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) options.frame_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) options.width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-height") == 0 && i + 1 < argc) options.height = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-path") == 0 && i + 1 < argc) options.path_file = argv[++i];
+        else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) options.json_path = argv[++i];
+        else if (strcmp(argv[i], "-wad") == 0 && i + 1 < argc) options.wad_path = argv[++i];
+        else if (argv[i][0] != '-') options.level_name = argv[i];
+        else
+        {
+            fprintf(stderr, "Uso: %s -timedemo [ExMy] [-frames N] [-width N] [-height N] [-path arquivo] [-json arquivo] [-wad arquivo]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.frame_count == 0 || options.width == 0 || options.height == 0)
+    {
+        fprintf(stderr, "Parametros invalidos\n");
+        return 1;
+    }
+
+    bool success = g_init_headless(options.width, options.height) && g_run_timedemo(&options);
+    g_shutdown();
+    return success ? 0 : 1;
+}
+
+// -golden arquivo [-update] [-maps E1M1,E1M2,...] [-threshold pct] [-width N] [-height N] [-wad arquivo]
+static int golden_main(int argc, char **argv)
+{
+    golden_options_t options = {
+        .wad_path = "resources/DOOM1.WAD",
+        .golden_path = argc > 2 ? argv[2] : NULL,
+        .maps = "E1M1",
+        .threshold = 0.2f,
+    };
+    uint16_t width = 320, height = 200;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-update") == 0) options.update = true;
+        else if (strcmp(argv[i], "-maps") == 0 && i + 1 < argc) options.maps = argv[++i];
+        else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc) options.threshold = atof(argv[++i]) / 100.f;
+        else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-height") == 0 && i + 1 < argc) height = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-wad") == 0 && i + 1 < argc) options.wad_path = argv[++i];
+        else options.golden_path = NULL;
+    }
+
+    if (options.golden_path == NULL || options.golden_path[0] == '-' || width == 0 || height == 0 || options.threshold < 0)
+    {
+        fprintf(stderr, "Uso: %s -golden arquivo [-update] [-maps E1M1,E1M2,...] [-threshold pct] [-width N] [-height N] [-wad arquivo]\n", argv[0]);
+        return 1;
+    }
+
+    int status = g_init_headless(width, height) ? g_run_golden(&options) : 1;
+    g_shutdown();
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-timedemo") == 0)
+        return timedemo_main(argc, argv);
+
+    if (argc > 1 && strcmp(argv[1], "-golden") == 0)
+        return golden_main(argc, argv);
+
     if (g_init(1280, 960))
     {
         g_run();
@@ -9,4 +89,4 @@ int main()
         g_shutdown();
     }
     return 0;
-}
\ No newline at end of file
+}
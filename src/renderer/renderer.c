@@ -2,28 +2,111 @@
 #include "window.h"
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_render.h>
 #include "logger.h"
+#include "utils.h"
+
+#if defined(R_INDEXED_COLOR) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define R_HAS_AVX2_EXPAND
+#endif
 
 #define MAX_SCALE 64.f
 #define MIN_SCALE 0.00390625f
+#define MIN_FIXED_SCALE (FRACUNIT / 256)
+// Alturas na tela em 20.12: z * escala passa de 16 bits inteiros em paredes próximas
+#define HEIGHTBITS 12
+#define HEIGHTUNIT (1 << HEIGHTBITS)
+#define FRAME_ARENA_SIZE (64 * 1024)
+#define VP_UNUSED 0xFFFF
+
+// Tabelas de luz no esquema do Doom: 16 faixas de luz de setor, cada uma com um colormap por escala
+// (paredes e sprites) ou por distância (chão e teto)
+#define LIGHT_LEVELS 16
+#define LIGHT_SEG_SHIFT 4
+#define LIGHT_COLORMAPS 32
+#define MAX_LIGHT_SCALE 48
+#define LIGHT_SCALE_UNIT 16.f // escala 1.0 -> índice 16
+#define LIGHT_SCALE_SHIFT (FRACBITS - 4)
+#define MAX_LIGHT_Z 128
+#define LIGHT_Z_UNIT 16.f     // unidades do mundo por índice de distância
+#define DIST_MAP 2
+#define REFERENCE_WIDTH 320
+
+// Região de chão/teto com a mesma altura, flat e luz, acumulada coluna a coluna durante o desenho
+// das paredes e rasterizada depois em spans horizontais
+typedef struct _visplane
+{
+    struct _visplane *next;
+    const image_t *texture;
+    float world_z;
+    int16_t light_level, min_x, max_x;
+    bool is_sky;
+    uint16_t *top, *bottom; // Indexados por x; as posições -1 e WIDTH ficam sempre livres
+} visplane_t;
+
+// Colunas de um trecho de parede já desenhado (drawseg do Doom), para recortar os sprites que ficam atrás dele.
+// Paredes sólidas cobrem a coluna inteira; portais guardam os limites de cima e de baixo depois do desenho,
+// só dos lados em que a diferença de altura entre os setores pode esconder algo (a silhueta)
+typedef struct _drawseg
+{
+    struct _drawseg *next;
+    int16_t x1, x2;
+    float scale1, scale2;
+    vertex_t seg_start, seg_end;
+    bool solid;
+    const int16_t *top_clip, *bottom_clip; // Indexados por x; NULL quando o lado não recorta
+} drawseg_t;
+
+typedef void (*expand_func_t)(const uint8_t *src, uint32_t *dst, size_t count, const uint32_t *palette);
+
+// Um frame desenhado e ainda não apresentado; no modo de 8 bits leva junto a paleta com que foi desenhado
+typedef struct _frame_buffer
+{
+    pixel_t *pixels;
+    uint16_t width, height; // Resolução com que o frame foi desenhado
+#ifdef R_INDEXED_COLOR
+    uint32_t palette[256];
+#endif
+} frame_buffer_t;
 
 typedef struct _renderer
 {
     SDL_Renderer *handler;
     SDL_Texture *screen_texture;
-    uint32_t *screen_buffer;
-    uint32_t screen_buffer_size;
+    pixel_t *screen_buffer; // Pixels do frame em desenho (frames[draw_frame])
+    uint32_t screen_buffer_size; // Bytes de cada framebuffer, na resolução máxima
+    frame_buffer_t frames[MAX_FRAME_BUFFERS];
+    uint8_t frame_count, draw_frame, presented_frame;
+    bool headless; // Sem janela: r_present só marca o frame para r_read_frame/r_write_ppm
+#ifdef R_INDEXED_COLOR
+    uint32_t *present_buffer;
+    expand_func_t expand;
+#endif
+    pixel_t colormaps[COLORMAP_COUNT][256];
+    uint32_t palette[256]; // RGBA de cada índice com a paleta e a gama atuais
+    uint8_t gamma_table[GAMMA_LEVELS][256];
+    uint8_t palette_index, gamma_level;
+    bool colormaps_dirty;
     uint16_t resolution_width, resolution_height;
+    uint16_t max_width, max_height; // Tamanho reservado por r_init; r_set_resolution só escolhe até ele
     vec3f_t camera_pos;
     float camera_angle;
     float screen_dist;
     float *x_to_angle;
-    int16_t *upper_clip;
+    int16_t view_angle_to_x[FINEANGLES / 2]; // Ângulo fino relativo à câmera, a partir de -90 graus -> coluna
+    bool fixed_point_walls;
+    int16_t *upper_clip; // Compartilhados pelas faixas: cada uma só toca as próprias colunas
     int16_t *lower_clip;
-    float *depth_buffer; // TODO: Criar um vetor de flags tamanho 1 byte para indicar se é uma solid wall, upper, lower ou up_low
+    arena_t frame_arena;
+    render_strip_t *strips;
+    uint16_t strip_count;
+    uint16_t active_strip_count; // No máximo uma faixa por coluna: numa tela mais estreita as que sobram ficam paradas
+    uint8_t scale_light[LIGHT_LEVELS][MAX_LIGHT_SCALE];
+    uint8_t z_light[LIGHT_LEVELS][MAX_LIGHT_Z];
 } rederer_t;
 
 static rederer_t renderer = {
@@ -33,57 +116,272 @@ static rederer_t renderer = {
     .screen_buffer_size = 0,
     .resolution_width = 0,
     .resolution_height = 0,
+    .max_width = 0,
+    .max_height = 0,
     .camera_pos = (vec3f_t){0, 0, 0},
     .screen_dist = 0,
     .x_to_angle = NULL,
+    .fixed_point_walls = true,
     .upper_clip = NULL,
     .lower_clip = NULL,
-    .depth_buffer = NULL,
+    .strips = NULL,
+    .strip_count = 0,
+    .active_strip_count = 0,
+    .colormaps_dirty = true,
 };
 
-float max_depth = 0.f;
-float min_depth = 0.f;
-
 static bool initialized = false;
 
 #define WIDTH renderer.resolution_width
 #define HEIGHT renderer.resolution_height
 #define H_WIDTH (WIDTH / 2.f)
 #define H_HEIGHT (HEIGHT / 2.f)
+#define MIN(_a, _b) ((_a) < (_b) ? (_a) : (_b))
+#define MAX(_a, _b) ((_a) > (_b) ? (_a) : (_b))
+#define CENTER_Y_FRAC ((fixed_t)HEIGHT << (FRACBITS - 1))
+#define CENTER_Y_HEIGHT ((fixed_t)HEIGHT << (HEIGHTBITS - 1))
+
+// Passos de uma parede no caminho de ponto fixo: a escala e a coluna da textura vezes a escala
+// são afins em x na tela, então cada coluna custa somas e duas divisões inteiras
+typedef struct _wall_steps
+{
+    fixed_t scale, scale_step;
+    // Para a textura a escala não pode ser limitada, senão u * escala deixa de ser afim perto da câmera
+    int64_t u_scale, u_scale_step, u_scaled, u_scaled_step; // 16.16
+} wall_steps_t;
 
-static bool r_init_screen()
+// Uma borda da parede na tela (topo, base ou abertura do portal) em 20.12
+typedef struct _wall_edge
 {
-    renderer.screen_buffer_size = WIDTH * HEIGHT * sizeof(uint32_t);
-    renderer.screen_buffer = malloc(renderer.screen_buffer_size);
+    fixed_t frac, step;
+} wall_edge_t;
 
-    if (renderer.screen_buffer != NULL)
+#ifdef R_INDEXED_COLOR
+// Índices da paleta -> RGBA na apresentação
+static void r_expand_scalar(const uint8_t *src, uint32_t *dst, size_t count, const uint32_t *palette)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        dst[i] = palette[src[i]];
+        dst[i + 1] = palette[src[i + 1]];
+        dst[i + 2] = palette[src[i + 2]];
+        dst[i + 3] = palette[src[i + 3]];
+    }
+
+    for (; i < count; i++)
+        dst[i] = palette[src[i]];
+}
+
+#ifdef R_HAS_AVX2_EXPAND
+// 16 índices por iteração: expande os bytes para 32 bits e busca as cores com gather
+__attribute__((target("avx2")))
+static void r_expand_avx2(const uint8_t *src, uint32_t *dst, size_t count, const uint32_t *palette)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i indices = _mm_loadu_si128((const __m128i*)(src + i));
+        __m256i low = _mm256_cvtepu8_epi32(indices);
+        __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)palette, low, 4));
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_i32gather_epi32((const int*)palette, high, 4));
+    }
+
+    r_expand_scalar(src + i, dst + i, count - i, palette);
+}
+#endif
+#endif
+
+static void r_create_gamma_tables()
+{
+    // Nível 0 é a identidade; os demais clareiam os tons escuros como o gamma do Doom
+    for (int level = 0; level < GAMMA_LEVELS; level++)
+    {
+        float exponent = 1.f / (1.f + level * 0.25f);
+        for (int i = 0; i < 256; i++)
+            renderer.gamma_table[level][i] = (uint8_t)(255.f * powf(i / 255.f, exponent) + 0.5f);
+    }
+}
+
+// Refaz a paleta de saída e os colormaps quando a paleta ou a gama mudam: O(256) por tabela, não por pixel
+static void r_update_colormaps()
+{
+    const palette_t *palette = a_get_palette(renderer.palette_index);
+    const uint8_t *colormaps = a_get_colormaps();
+    if (palette == NULL || colormaps == NULL) return;
+
+    const uint8_t *gamma = renderer.gamma_table[renderer.gamma_level];
+    for (int i = 0; i < 256; i++)
+        renderer.palette[i] = (0xFFu << 24) | (gamma[palette[i].b] << 16) | (gamma[palette[i].g] << 8) | gamma[palette[i].r];
+
+    pixel_t *dest = &renderer.colormaps[0][0];
+    for (int i = 0; i < COLORMAP_COUNT * 256; i++)
+    {
+#ifdef R_INDEXED_COLOR
+        dest[i] = colormaps[i];
+#else
+        dest[i] = renderer.palette[colormaps[i]];
+#endif
+    }
+
+    renderer.colormaps_dirty = false;
+}
+
+static void r_delete_frame_buffers()
+{
+    for (uint8_t i = 0; i < renderer.frame_count; i++)
+        free(renderer.frames[i].pixels);
+
+    memset(renderer.frames, 0, sizeof(renderer.frames));
+    renderer.frame_count = 0;
+    renderer.draw_frame = 0;
+    renderer.screen_buffer = NULL;
+}
+
+bool r_set_frame_buffer_count(uint8_t count)
+{
+    if (count < 1) count = 1;
+    if (count > MAX_FRAME_BUFFERS) count = MAX_FRAME_BUFFERS;
+    if (count == renderer.frame_count) return true;
+
+    r_delete_frame_buffers();
+    for (uint8_t i = 0; i < count; i++)
+    {
+        renderer.frames[i].pixels = (pixel_t*)calloc(1, renderer.screen_buffer_size);
+        if (renderer.frames[i].pixels == NULL)
+        {
+            DOOM_LOG_ERROR("Nao foi possivel alocar os framebuffers");
+            r_delete_frame_buffers();
+            return false;
+        }
+
+        renderer.frame_count++;
+    }
+
+    renderer.screen_buffer = renderer.frames[0].pixels;
+    return true;
+}
+
+void r_set_draw_buffer(uint8_t index)
+{
+    renderer.draw_frame = index < renderer.frame_count ? index : 0;
+    renderer.screen_buffer = renderer.frames[renderer.draw_frame].pixels;
+}
+
+static bool r_init_buffers()
+{
+    renderer.screen_buffer_size = renderer.max_width * renderer.max_height * sizeof(pixel_t);
+    if (!r_set_frame_buffer_count(1))
+        return false;
+
+#ifdef R_INDEXED_COLOR
+    renderer.present_buffer = malloc(renderer.max_width * renderer.max_height * sizeof(uint32_t));
+    if (renderer.present_buffer == NULL)
+    {
+        r_delete_frame_buffers();
+        return false;
+    }
+
+    renderer.expand = r_expand_scalar;
+#ifdef R_HAS_AVX2_EXPAND
+    if (__builtin_cpu_supports("avx2"))
+        renderer.expand = r_expand_avx2;
+#endif
+#endif
+
+    return true;
+}
+
+static void r_delete_buffers()
+{
+    r_delete_frame_buffers();
+#ifdef R_INDEXED_COLOR
+    free(renderer.present_buffer);
+    renderer.present_buffer = NULL;
+#endif
+}
+
+static bool r_init_screen()
+{
+    if (r_init_buffers())
     {
         SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
         renderer.screen_texture = SDL_CreateTexture(renderer.handler, 
                                                     SDL_PIXELFORMAT_RGBA32, 
                                                     SDL_TEXTUREACCESS_STREAMING, 
-                                                    WIDTH, 
-                                                    HEIGHT);
-        memset(renderer.screen_buffer, 0, renderer.screen_buffer_size);
+                                                    renderer.max_width, 
+                                                    renderer.max_height);
         
         if (renderer.screen_texture != NULL)
             return true;
 
-        free(renderer.screen_buffer);
+        r_delete_buffers();
     }
 
     DOOM_LOG_ERROR("Nao foi possivel iniciar o buffer de renderizacao");
     return false;
 }
 
+static uint8_t r_clamp_colormap(int level)
+{
+    if (level < 0) return 0;
+    if (level >= LIGHT_COLORMAPS) return LIGHT_COLORMAPS - 1;
+    return level;
+}
+
+static void r_create_light_tables()
+{
+    for (int i = 0; i < LIGHT_LEVELS; i++)
+    {
+        int start_map = ((LIGHT_LEVELS - 1 - i) * 2) * LIGHT_COLORMAPS / LIGHT_LEVELS;
+
+        // Quanto maior a escala (mais perto), mais claro; o fator de largura deixa a luz igual em qualquer resolução
+        for (int j = 0; j < MAX_LIGHT_SCALE; j++)
+            renderer.scale_light[i][j] = r_clamp_colormap(start_map - j * REFERENCE_WIDTH / WIDTH / DIST_MAP);
+
+        for (int j = 0; j < MAX_LIGHT_Z; j++)
+            renderer.z_light[i][j] = r_clamp_colormap(start_map - (REFERENCE_WIDTH / 2) / (j + 1) / DIST_MAP);
+    }
+}
+
+static uint8_t r_light_index(int16_t light_level)
+{
+    int index = light_level >> LIGHT_SEG_SHIFT;
+    if (index < 0) return 0;
+    return index >= LIGHT_LEVELS ? LIGHT_LEVELS - 1 : index;
+}
+
+// Tabelas que dependem da resolução atual; os arrays já têm o tamanho máximo
+static void r_build_view_tables()
+{
+    renderer.screen_dist = (float)(H_WIDTH) / tanf(H_FOV);
+
+    for (uint32_t i = 0; i <= WIDTH; i++)
+        renderer.x_to_angle[i] = atanf(((H_WIDTH) - i) / renderer.screen_dist);
+
+    u_init_trig_tables();
+    for (uint32_t i = 0; i < FINEANGLES / 2; i++)
+    {
+        float x = floorf((float)(H_WIDTH) - u_fine_tangent(((angle_t)i << ANGLETOFINESHIFT) - ANG90) * renderer.screen_dist);
+        renderer.view_angle_to_x[i] = x < 0 ? 0 : (x > WIDTH ? WIDTH : (int16_t)x);
+    }
+
+    // As bordas do campo de visão caem no início de um índice e precisam ser exatas
+    renderer.view_angle_to_x[(ANG90 + ANG45) >> ANGLETOFINESHIFT] = 0;
+    renderer.view_angle_to_x[(ANG90 - ANG45) >> ANGLETOFINESHIFT] = WIDTH;
+
+    r_create_light_tables();
+}
+
 static bool r_create_tables()
 {
-    renderer.x_to_angle = (float*)malloc((WIDTH + 1) * sizeof(float));
+    renderer.x_to_angle = (float*)malloc((renderer.max_width + 1) * sizeof(float));
 
     if (renderer.x_to_angle == NULL)
         return false;
 
-    renderer.upper_clip = (int16_t*)malloc(WIDTH * sizeof(int16_t));
+    renderer.upper_clip = (int16_t*)malloc(renderer.max_width * sizeof(int16_t));
 
     if (renderer.upper_clip == NULL)
     {
@@ -91,7 +389,7 @@ static bool r_create_tables()
         return false;
     }
 
-    renderer.lower_clip = (int16_t*)malloc(WIDTH * sizeof(int16_t));
+    renderer.lower_clip = (int16_t*)malloc(renderer.max_width * sizeof(int16_t));
 
     if (renderer.lower_clip == NULL)
     {
@@ -100,31 +398,97 @@ static bool r_create_tables()
         return false;
     }
 
-    renderer.depth_buffer = (float*)malloc(WIDTH * HEIGHT * sizeof(float));
+    r_build_view_tables();
+    r_create_gamma_tables();
+    return true;
+}
 
-    if (renderer.depth_buffer == NULL)
+static void r_delete_strips()
+{
+    for (uint16_t i = 0; i < renderer.strip_count; i++)
     {
-        free(renderer.x_to_angle);
-        free(renderer.upper_clip);
-        free(renderer.lower_clip);
+        ar_destroy(&renderer.strips[i].arena);
+        free(renderer.strips[i].span_start);
+    }
+
+    free(renderer.strips);
+    renderer.strips = NULL;
+    renderer.strip_count = renderer.active_strip_count = 0;
+}
+
+static void r_update_strip_ranges()
+{
+    renderer.active_strip_count = MIN(renderer.strip_count, WIDTH);
+    for (uint16_t i = 0; i < renderer.active_strip_count; i++)
+    {
+        renderer.strips[i].x_start = i * WIDTH / renderer.active_strip_count;
+        renderer.strips[i].x_end = (i + 1) * WIDTH / renderer.active_strip_count - 1;
+    }
+}
+
+bool r_set_strip_count(uint16_t count)
+{
+    if (count < 1) count = 1;
+    if (count > renderer.max_width) count = renderer.max_width;
+    if (count == renderer.strip_count) return true;
+
+    r_delete_strips();
+    renderer.strips = (render_strip_t*)calloc(count, sizeof(render_strip_t));
+    if (renderer.strips == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel alocar as faixas da tela");
         return false;
     }
 
-    for (uint32_t i = 0; i <= WIDTH; i++)
-        renderer.x_to_angle[i] = atanf(((H_WIDTH) - i) / renderer.screen_dist);
+    renderer.strip_count = count;
+    r_update_strip_ranges();
+    for (uint16_t i = 0; i < count; i++)
+    {
+        render_strip_t *strip = &renderer.strips[i];
+        strip->arena = ar_create(FRAME_ARENA_SIZE, true);
+        strip->span_start = (int16_t*)malloc(renderer.max_height * sizeof(int16_t));
+
+        if (strip->arena.base == NULL || strip->span_start == NULL)
+        {
+            DOOM_LOG_ERROR("Nao foi possivel alocar as faixas da tela");
+            r_delete_strips();
+            return false;
+        }
+    }
 
     return true;
 }
 
-bool r_init(uint16_t scrn_w, uint16_t scrn_h)
+uint16_t r_get_strip_count()
 {
-    SDL_Window *win = (SDL_Window*)w_get_handler();
-    renderer.resolution_width = scrn_w;
-    renderer.resolution_height = scrn_h;
-    renderer.screen_dist = (float)(H_WIDTH) / tanf(H_FOV);
+    return renderer.active_strip_count;
+}
+
+render_strip_t *r_get_strip(uint16_t index)
+{
+    return &renderer.strips[index];
+}
+
+// Parte comum aos dois backends: tabelas, arena do frame e faixas
+static bool r_init_common(uint16_t scrn_w, uint16_t scrn_h)
+{
+    renderer.resolution_width = renderer.max_width = scrn_w;
+    renderer.resolution_height = renderer.max_height = scrn_h;
     
     if (!r_create_tables()) return false;
 
+    // Memória de rascunho do frame; cresce até o pico de uso e é zerada em r_begin_draw
+    renderer.frame_arena = ar_create(FRAME_ARENA_SIZE, true);
+
+    return r_set_strip_count(1);
+}
+
+bool r_init(uint16_t scrn_w, uint16_t scrn_h)
+{
+    SDL_Window *win = (SDL_Window*)w_get_handler();
+    if (!r_init_common(scrn_w, scrn_h)) return false;
+
+    renderer.headless = false;
     renderer.handler = SDL_CreateRenderer(win, -1, SDL_RENDERER_SOFTWARE);
 
     if (renderer.handler == NULL)
@@ -139,21 +503,70 @@ bool r_init(uint16_t scrn_w, uint16_t scrn_h)
         return false;
     }
 
-    SDL_RenderSetLogicalSize(renderer.handler, WIDTH, HEIGHT);
+    SDL_RenderSetLogicalSize(renderer.handler, renderer.max_width, renderer.max_height);
     initialized = true;
     return true;
 }
 
-void r_begin_draw(const player_t *player)
+bool r_init_headless(uint16_t scrn_w, uint16_t scrn_h)
 {
-    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++)
+    if (!r_init_common(scrn_w, scrn_h)) return false;
+
+    // Sem janela nem SDL_Renderer: o frame apresentado fica na memória
+    renderer.headless = true;
+    renderer.handler = NULL;
+    renderer.screen_texture = NULL;
+
+    if (!r_init_buffers())
     {
-        renderer.screen_buffer[i] = 0;
-        renderer.depth_buffer[i] = FLT_MAX;
+        DOOM_LOG_ERROR("Nao foi possivel iniciar o buffer de renderizacao");
+        return false;
     }
 
-    min_depth = FLT_MAX;
-    max_depth = 0.f;
+    initialized = true;
+    return true;
+}
+
+bool r_set_resolution(uint16_t width, uint16_t height)
+{
+    if (width == WIDTH && height == HEIGHT) return true;
+    if (width == 0 || height == 0 || width > renderer.max_width || height > renderer.max_height) return false;
+
+    // Nada é alocado: os buffers e tabelas já têm o tamanho máximo, só o conteúdo é refeito
+    WIDTH = width;
+    HEIGHT = height;
+    r_build_view_tables();
+    r_update_strip_ranges();
+    return true;
+}
+
+void r_get_max_resolution(uint16_t *width, uint16_t *height)
+{
+    *width = renderer.max_width;
+    *height = renderer.max_height;
+}
+
+void r_begin_draw(const player_t *player)
+{
+    ar_reset(&renderer.frame_arena);
+
+    if (renderer.colormaps_dirty)
+        r_update_colormaps();
+
+    frame_buffer_t *frame = &renderer.frames[renderer.draw_frame];
+    frame->width = WIDTH;
+    frame->height = HEIGHT;
+#ifdef R_INDEXED_COLOR
+    memcpy(frame->palette, renderer.palette, sizeof(renderer.palette));
+#endif
+    memset(renderer.screen_buffer, 0, WIDTH * HEIGHT * sizeof(pixel_t));
+
+    for (uint16_t i = 0; i < renderer.strip_count; i++)
+    {
+        ar_reset(&renderer.strips[i].arena);
+        renderer.strips[i].planes = NULL;
+        renderer.strips[i].drawsegs = NULL;
+    }
     
     for (uint16_t i = 0; i < WIDTH; i++) 
     {
@@ -165,13 +578,13 @@ void r_begin_draw(const player_t *player)
     renderer.camera_angle = player->angle;
 }
 
-void r_draw_pixel(int x, int y, uint32_t color)
+void r_draw_pixel(int x, int y, pixel_t color)
 {
-    if (x < 0 || x > WIDTH || y < 0 || y > HEIGHT || (color & 0xFF000000) == 0) return;
+    if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
     renderer.screen_buffer[WIDTH * y + x] = color;
 }
 
-void r_draw_vertical_line(int16_t x, int16_t y1, int16_t y2, const char *wall_texture, int16_t light_level, uint32_t color)
+void r_draw_vertical_line(int16_t x, int16_t y1, int16_t y2, const char *wall_texture, int16_t light_level, pixel_t color)
 {
     if (y1 < 0) y1 = 0;
     if (y2 > HEIGHT) y2 = HEIGHT;
@@ -181,74 +594,292 @@ void r_draw_vertical_line(int16_t x, int16_t y1, int16_t y2, const char *wall_te
         renderer.screen_buffer[WIDTH * i + x] = color; 
 }
 
-void r_draw_wall_col(const char *texture_name, float texture_column, int16_t x, int16_t y1, int16_t y2, float texture_alt, float inv_scale, int16_t light_level, float depth)
+const pixel_t *r_get_colormap(uint8_t index)
+{
+    return renderer.colormaps[index < COLORMAP_COUNT ? index : 0];
+}
+
+const pixel_t *r_get_light_colormap(int16_t light_level, float scale)
+{
+    float index = scale * LIGHT_SCALE_UNIT;
+    return renderer.colormaps[renderer.scale_light[r_light_index(light_level)][index < MAX_LIGHT_SCALE - 1 ? (int)index : MAX_LIGHT_SCALE - 1]];
+}
+
+void r_set_palette(uint8_t palette_index)
+{
+    if (palette_index == renderer.palette_index) return;
+    renderer.palette_index = palette_index;
+    renderer.colormaps_dirty = true;
+}
+
+void r_set_gamma(uint8_t level)
+{
+    if (level >= GAMMA_LEVELS) level = GAMMA_LEVELS - 1;
+    if (level == renderer.gamma_level) return;
+    renderer.gamma_level = level;
+    renderer.colormaps_dirty = true;
+}
+
+void r_draw_wall_col(const image_t *texture, float texture_column, int16_t x, int16_t y1, int16_t y2, float texture_alt, float inv_scale, const pixel_t *colormap)
 {
-    image_t *texture = a_get_texture_by_name(texture_name);
     if (texture != NULL && y1 < y2)
     {
         int16_t col = (int16_t)(texture_column) % texture->width;
+        if (col < 0) col += texture->width;
+
+        // A coluna da textura é contígua, então cada pixel lê o byte seguinte (ou quase) da mesma linha de cache
+        const uint8_t *source = i_get_column(texture, col);
+        int16_t height = texture->height;
         float tex_y = texture_alt + ((float)y1 - H_HEIGHT) * inv_scale;
 
         for (uint16_t y = y1; y <= y2; y++)
         {
             uint32_t i = WIDTH * y + x;
-            if (depth < renderer.depth_buffer[i])
-                renderer.depth_buffer[i] = depth;
-
+            int16_t row = (int16_t)tex_y % height;
+            if (row < 0) row += height;
 
-            uint32_t color = texture->data[((int16_t)tex_y % texture->height) * texture->width + col];
-            renderer.screen_buffer[i] = color;
+            renderer.screen_buffer[i] = colormap[source[row]];
             tex_y += inv_scale;
         }
     }
 }
 
-void r_draw_flat(const char *texture_name, int16_t x, int16_t y1, int16_t y2, float world_z, int16_t light_level)
+static bool r_is_same_plane(const visplane_t *plane, const image_t *texture, bool is_sky, float world_z, int16_t light_level)
+{
+    // O céu só depende da coluna, então todos os setores de céu dividem o mesmo plano
+    if (plane->texture != texture || plane->is_sky != is_sky) return false;
+    return is_sky || (plane->world_z == world_z && plane->light_level == light_level);
+}
+
+static visplane_t *r_create_plane(render_strip_t *strip, const image_t *texture, bool is_sky, float world_z, int16_t light_level)
+{
+    // Só as colunas da faixa, mais uma livre de cada lado
+    size_t columns = strip->x_end - strip->x_start + 3;
+    visplane_t *plane = ar_alloc(&strip->arena, sizeof(visplane_t) + 2 * columns * sizeof(uint16_t), AR_CACHE_LINE);
+    if (plane == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel alocar um visplane");
+        return NULL;
+    }
+
+    plane->texture = texture;
+    plane->is_sky = is_sky;
+    plane->world_z = world_z;
+    plane->light_level = light_level;
+    plane->min_x = WIDTH;
+    plane->max_x = -1;
+    plane->top = (uint16_t*)(plane + 1) + 1 - strip->x_start;
+    plane->bottom = plane->top + columns;
+    memset(plane->top + strip->x_start - 1, 0xFF, columns * sizeof(uint16_t));
+    memset(plane->bottom + strip->x_start - 1, 0, columns * sizeof(uint16_t));
+
+    plane->next = strip->planes;
+    strip->planes = plane;
+    return plane;
+}
+
+static visplane_t *r_find_plane(render_strip_t *strip, const image_t *texture, bool is_sky, float world_z, int16_t light_level)
 {
-    if (strcmp(texture_name, "F_SKY1") == 0)
+    if (texture == NULL) return NULL;
+
+    for (visplane_t *plane = strip->planes; plane != NULL; plane = plane->next)
     {
-        float tex_column = 2.2f * (renderer.camera_angle + renderer.x_to_angle[x]);
-        r_draw_wall_col("SKY1", tex_column, x, y1, y2, 100.f, 1.5f, 1, FLT_MAX);
-        return;
+        if (r_is_same_plane(plane, texture, is_sky, world_z, light_level))
+            return plane;
     }
 
-    image_t *texture = a_get_flat_by_name(texture_name);
-    if (texture == NULL) return;
+    return r_create_plane(strip, texture, is_sky, world_z, light_level);
+}
 
-    float player_dir_x = cosf(renderer.camera_angle);
-    float player_dir_y = sinf(renderer.camera_angle);
+// Marca [y1, y2] da coluna x no plano. Se a coluna já foi usada, segue num plano igual com ela livre
+static visplane_t *r_mark_plane(render_strip_t *strip, visplane_t *plane, int16_t x, int16_t y1, int16_t y2)
+{
+    if (plane == NULL || y1 > y2) return plane;
 
-    for (uint16_t y = y1; y <= y2; y++)
+    if (plane->top[x] != VP_UNUSED)
     {
-        float z = H_WIDTH * world_z / (H_HEIGHT - y);
-        float px = player_dir_x * z + renderer.camera_pos.x;
-        float py = player_dir_y * z + renderer.camera_pos.y;
+        visplane_t *free_plane = strip->planes;
+        for (; free_plane != NULL; free_plane = free_plane->next)
+        {
+            if (free_plane->top[x] == VP_UNUSED && r_is_same_plane(free_plane, plane->texture, plane->is_sky, plane->world_z, plane->light_level))
+                break;
+        }
+
+        if (free_plane == NULL)
+            free_plane = r_create_plane(strip, plane->texture, plane->is_sky, plane->world_z, plane->light_level);
+
+        if (free_plane == NULL) return plane;
+        plane = free_plane;
+    }
+
+    plane->top[x] = y1;
+    plane->bottom[x] = y2;
+    if (x < plane->min_x) plane->min_x = x;
+    if (x > plane->max_x) plane->max_x = x;
+
+    return plane;
+}
+
+// As linhas da coluna x cobertas por uma parede desenhada depois saem do plano, como no desenho
+// coluna a coluna em que a parede sobrescrevia o chão/teto (acontece na linha 0 por causa do truncamento)
+static void r_unmark_plane(visplane_t *plane, int16_t x, int16_t y1, int16_t y2)
+{
+    if (plane == NULL || plane->top[x] == VP_UNUSED || y2 < plane->top[x] || y1 > plane->bottom[x]) return;
+
+    if (y1 <= plane->top[x] && y2 >= plane->bottom[x])
+    {
+        plane->top[x] = VP_UNUSED;
+        plane->bottom[x] = 0;
+    }
+    else if (y1 <= plane->top[x])
+        plane->top[x] = y2 + 1;
+    else
+        plane->bottom[x] = y1 - 1;
+}
 
-        float left_x = -player_dir_y * z + px;
-        float left_y = player_dir_x * z + py;
-        float right_x = player_dir_y * z + px;
-        float right_y = -player_dir_x * z + py;
+static void r_draw_span(const visplane_t *plane, int16_t y, int16_t x1, int16_t x2, float player_dir_x, float player_dir_y)
+{
+    // Distância e extremos do raio calculados uma vez por linha; o texel de cada x sai da mesma
+    // expressão usada coluna a coluna, então o resultado é idêntico
+    float z = H_WIDTH * plane->world_z / (H_HEIGHT - y);
+    float px = player_dir_x * z + renderer.camera_pos.x;
+    float py = player_dir_y * z + renderer.camera_pos.y;
+
+    float left_x = -player_dir_y * z + px;
+    float left_y = player_dir_x * z + py;
+    float right_x = player_dir_y * z + px;
+    float right_y = -player_dir_x * z + py;
+
+    float dx = (right_x - left_x) / WIDTH;
+    float dy = (right_y - left_y) / WIDTH;
+
+    float light_z = z / LIGHT_Z_UNIT;
+    int light_index = light_z >= 0 && light_z < MAX_LIGHT_Z ? (int)light_z : (light_z < 0 ? 0 : MAX_LIGHT_Z - 1);
+    const pixel_t *colormap = renderer.colormaps[renderer.z_light[r_light_index(plane->light_level)][light_index]];
 
-        float dx = (right_x - left_x) / WIDTH;
-        float dy = (right_y - left_y) / WIDTH;
+    const uint8_t *src = plane->texture->data;
+    uint16_t tex_width = plane->texture->width;
+    pixel_t *dest = renderer.screen_buffer + y * WIDTH;
 
+    for (int16_t x = x1; x <= x2; x++)
+    {
         int16_t tx = (int16_t)(left_x + dx * x) & 63;
         int16_t ty = (int16_t)(left_y + dy * x) & 63;
+        dest[x] = colormap[src[ty * tex_width + tx]];
+    }
+}
+
+// Converte a transição entre as colunas x - 1 e x em spans: linhas que saem do plano fecham um span,
+// linhas que entram abrem um novo
+static void r_make_spans(render_strip_t *strip, const visplane_t *plane, int16_t x, int t1, int b1, int t2, int b2, float player_dir_x, float player_dir_y)
+{
+    int16_t *span_start = strip->span_start;
+    while (t1 < t2 && t1 <= b1)
+    {
+        r_draw_span(plane, t1, span_start[t1], x - 1, player_dir_x, player_dir_y);
+        t1++;
+    }
+
+    while (b1 > b2 && b1 >= t1)
+    {
+        r_draw_span(plane, b1, span_start[b1], x - 1, player_dir_x, player_dir_y);
+        b1--;
+    }
 
-        uint32_t color = texture->data[ty * texture->width + tx];
-        renderer.screen_buffer[y * WIDTH + x] = color;
+    while (t2 < t1 && t2 <= b2)
+    {
+        span_start[t2] = x;
+        t2++;
+    }
+
+    while (b2 > b1 && b2 >= t2)
+    {
+        span_start[b2] = x;
+        b2--;
     }
 }
 
-void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
+void r_draw_planes(render_strip_t *strip)
 {
-    float rw_scale = r_scale_from_global_angle(portal_wall_desc->x1, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance);
+    float player_dir_x = cosf(renderer.camera_angle);
+    float player_dir_y = sinf(renderer.camera_angle);
+    const pixel_t *sky_colormap = renderer.colormaps[0];
+
+    for (visplane_t *plane = strip->planes; plane != NULL; plane = plane->next)
+    {
+        if (plane->min_x > plane->max_x) continue;
+
+        // Para o céu, texture é a textura SKY1 resolvida no carregamento do nível
+        if (plane->is_sky)
+        {
+            for (int16_t x = plane->min_x; x <= plane->max_x; x++)
+            {
+                if (plane->top[x] == VP_UNUSED) continue;
+
+                float tex_column = 2.2f * (renderer.camera_angle + renderer.x_to_angle[x]);
+                r_draw_wall_col(plane->texture, tex_column, x, plane->top[x], plane->bottom[x], 100.f, 1.5f, sky_colormap);
+            }
+            continue;
+        }
+
+        for (int16_t x = plane->min_x; x <= plane->max_x + 1; x++)
+            r_make_spans(strip, plane, x, plane->top[x - 1], plane->bottom[x - 1], plane->top[x], plane->bottom[x], player_dir_x, player_dir_y);
+    }
+}
+
+static void r_store_drawseg(render_strip_t *strip, int16_t x1, int16_t x2, float scale1, float scale2, vertex_t seg_start, vertex_t seg_end, bool solid, bool clip_top, bool clip_bottom)
+{
+    // Só as colunas desenhadas nesta faixa
+    if (x1 < strip->x_start) x1 = strip->x_start;
+    if (x2 > strip->x_end) x2 = strip->x_end;
+    if (x1 > x2 || (!solid && !clip_top && !clip_bottom)) return;
+
+    size_t columns = x2 - x1 + 1;
+    size_t clip_count = solid ? 0 : (clip_top + clip_bottom) * columns;
+    drawseg_t *drawseg = ar_alloc(&strip->arena, sizeof(drawseg_t) + clip_count * sizeof(int16_t), 8);
+    if (drawseg == NULL)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel alocar um drawseg");
+        return;
+    }
+
+    drawseg->x1 = x1;
+    drawseg->x2 = x2;
+    drawseg->scale1 = scale1;
+    drawseg->scale2 = scale2;
+    drawseg->seg_start = seg_start;
+    drawseg->seg_end = seg_end;
+    drawseg->solid = solid;
+    drawseg->top_clip = NULL;
+    drawseg->bottom_clip = NULL;
+
+    int16_t *clips = (int16_t*)(drawseg + 1);
+    if (!solid && clip_top)
+    {
+        memcpy(clips, renderer.upper_clip + x1, columns * sizeof(int16_t));
+        drawseg->top_clip = clips - x1;
+        clips += columns;
+    }
+
+    if (!solid && clip_bottom)
+    {
+        memcpy(clips, renderer.lower_clip + x1, columns * sizeof(int16_t));
+        drawseg->bottom_clip = clips - x1;
+    }
+
+    drawseg->next = strip->drawsegs;
+    strip->drawsegs = drawseg;
+}
+
+static void r_draw_portal_wall_range_float(render_strip_t *strip, portal_wall_desc_t *portal_wall_desc)
+{
+    float rw_scale = r_scale_from_global_angle(portal_wall_desc->seg_x1, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance);
     float rw_scale_step = 0;
     
-    if (portal_wall_desc->x1 < portal_wall_desc->x2)
+    if (portal_wall_desc->seg_x1 < portal_wall_desc->seg_x2)
     {
-        float scale2 = r_scale_from_global_angle(portal_wall_desc->x2, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance);
-        rw_scale_step = (scale2 - rw_scale) / (portal_wall_desc->x2 - portal_wall_desc->x1);
+        float scale2 = r_scale_from_global_angle(portal_wall_desc->seg_x2, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance);
+        rw_scale_step = (scale2 - rw_scale) / (portal_wall_desc->seg_x2 - portal_wall_desc->seg_x1);
     }
 
     float wall_y1 = H_HEIGHT - portal_wall_desc->world_front_z1 * rw_scale;
@@ -256,6 +887,9 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
 
     float wall_y2 = H_HEIGHT - portal_wall_desc->world_front_z2 * rw_scale;
     float wall_y2_step = -rw_scale_step * portal_wall_desc->world_front_z2;
+
+    visplane_t *ceil_plane = portal_wall_desc->draw_ceil ? r_find_plane(strip, portal_wall_desc->ceil_texture, portal_wall_desc->ceil_is_sky, portal_wall_desc->world_front_z1, portal_wall_desc->light_level) : NULL;
+    visplane_t *floor_plane = portal_wall_desc->draw_floor ? r_find_plane(strip, portal_wall_desc->floor_texture, portal_wall_desc->floor_is_sky, portal_wall_desc->world_front_z2, portal_wall_desc->light_level) : NULL;
     
     float portal_y1 = wall_y2;
     float portal_y1_step = wall_y2_step;
@@ -275,10 +909,21 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
         portal_y2_step = -rw_scale_step * portal_wall_desc->world_back_z2;
     }
 
-    float angle, texture_column, inv_scale;
-    for (int16_t x = portal_wall_desc->x1; x < portal_wall_desc->x2; x++)
+    float angle = 0, texture_column = 0, inv_scale = 0;
+    const pixel_t *colormap = NULL;
+    for (int16_t x = portal_wall_desc->seg_x1; x < portal_wall_desc->x2 && x <= strip->x_end; x++)
     {
-        float depth = portal_wall_desc->rw_distance / cosf(portal_wall_desc->rw_normal_angle - renderer.x_to_angle[x] - renderer.camera_angle);
+        if (x < strip->x_start || x < portal_wall_desc->x1)
+        {
+            // Coluna recortada ou de outra faixa: só avança os passos, para que as colunas desenhadas
+            // recebam exatamente os mesmos valores do seg inteiro
+            if (portal_wall_desc->draw_upper_wall) portal_y1 += portal_y1_step;
+            if (portal_wall_desc->draw_lower_wall) portal_y2 += portal_y2_step;
+            rw_scale += rw_scale_step;
+            wall_y1 += wall_y1_step;
+            wall_y2 += wall_y2_step;
+            continue;
+        }
 
         float draw_wall_y1 = wall_y1 - 1;
 
@@ -287,6 +932,7 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
             angle = portal_wall_desc->rw_center_angle - renderer.x_to_angle[x];
             texture_column = portal_wall_desc->rw_distance * tanf(angle) - portal_wall_desc->rw_offset;
             inv_scale = 1.0f / rw_scale;
+            colormap = r_get_light_colormap(portal_wall_desc->light_level, rw_scale);
         }
 
         if (portal_wall_desc->draw_upper_wall)
@@ -297,12 +943,14 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
             {
                 int16_t cy1 = renderer.upper_clip[x] + 1;
                 int16_t cy2 = (int16_t)(fmin(draw_wall_y1 - 1, renderer.lower_clip[x] - 1));
-                r_draw_flat(portal_wall_desc->ceil_texture, x, cy1, cy2, portal_wall_desc->world_front_z1, portal_wall_desc->light_level);
+                ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
             }
 
             int16_t wy1 = (int16_t)(fmax(draw_upper_wall_y1, renderer.upper_clip[x] + 1));
             int16_t wy2 = (int16_t)(fmin(portal_y1, renderer.lower_clip[x] - 1));
-            r_draw_wall_col(portal_wall_desc->upper_wall_texture, texture_column, x, wy1, wy2, portal_wall_desc->upper_tex_alt, inv_scale, portal_wall_desc->light_level, depth);
+            if (portal_wall_desc->upper_wall_texture != NULL && wy1 < wy2)
+                r_unmark_plane(ceil_plane, x, wy1, wy2);
+            r_draw_wall_col(portal_wall_desc->upper_wall_texture, texture_column, x, wy1, wy2, portal_wall_desc->upper_tex_alt, inv_scale, colormap);
 
             if (renderer.upper_clip[x] < wy2)
                 renderer.upper_clip[x] = wy2;
@@ -314,7 +962,7 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
         {
             int16_t cy1 = renderer.upper_clip[x] + 1;
             int16_t cy2 = (int16_t)(fmin(draw_wall_y1 - 1, renderer.lower_clip[x] - 1));
-            r_draw_flat(portal_wall_desc->ceil_texture, x, cy1, cy2, portal_wall_desc->world_front_z1, portal_wall_desc->light_level);
+            ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
 
             if (renderer.upper_clip[x] < cy2)
                 renderer.upper_clip[x] = cy2;
@@ -327,14 +975,16 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
                 int16_t fy1 = (int16_t)(fmax(wall_y2 + 1, renderer.upper_clip[x] + 1));
                 int16_t fy2 = renderer.lower_clip[x] - 1;
 
-                r_draw_flat(portal_wall_desc->floor_texture, x, fy1, fy2, portal_wall_desc->world_front_z2, portal_wall_desc->light_level);
+                floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
             }
 
             float draw_lower_wall_y1 = portal_y2 - 1;
 
             int16_t wy1 = (int16_t)(fmax(draw_lower_wall_y1, renderer.upper_clip[x] + 1));
             int16_t wy2 = (int16_t)(fmin(wall_y2, renderer.lower_clip[x] - 1));
-            r_draw_wall_col(portal_wall_desc->lower_wall_texture, texture_column, x, wy1, wy2, portal_wall_desc->lower_tex_alt, inv_scale, portal_wall_desc->light_level, depth);
+            if (portal_wall_desc->lower_wall_texture != NULL && wy1 < wy2)
+                r_unmark_plane(floor_plane, x, wy1, wy2);
+            r_draw_wall_col(portal_wall_desc->lower_wall_texture, texture_column, x, wy1, wy2, portal_wall_desc->lower_tex_alt, inv_scale, colormap);
             
             if (renderer.lower_clip[x] > wy1)
                 renderer.lower_clip[x] = wy1;
@@ -346,7 +996,7 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
         {
             int16_t fy1 = (int16_t)(fmax(wall_y2 + 1, renderer.upper_clip[x] + 1));
             int16_t fy2 = renderer.lower_clip[x] - 1;
-            r_draw_flat(portal_wall_desc->floor_texture, x, fy1, fy2, portal_wall_desc->world_front_z2, portal_wall_desc->light_level);
+            floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
 
             if (renderer.lower_clip[x] > wall_y2 + 1)
                 renderer.lower_clip[x] = fy1;
@@ -358,15 +1008,15 @@ void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc)
     }
 }
 
-void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
+static void r_draw_solid_wall_range_float(render_strip_t *strip, solid_wall_desc_t *solid_wall_desc)
 {
-    float rw_scale = r_scale_from_global_angle(solid_wall_desc->x1, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance);
+    float rw_scale = r_scale_from_global_angle(solid_wall_desc->seg_x1, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance);
     float rw_scale_step = 0;
     
-    if (solid_wall_desc->x1 < solid_wall_desc->x2)
+    if (solid_wall_desc->seg_x1 < solid_wall_desc->seg_x2)
     {
-        float scale2 = r_scale_from_global_angle(solid_wall_desc->x2, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance);
-        rw_scale_step = (scale2 - rw_scale) / (solid_wall_desc->x2 - solid_wall_desc->x1);
+        float scale2 = r_scale_from_global_angle(solid_wall_desc->seg_x2, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance);
+        rw_scale_step = (scale2 - rw_scale) / (solid_wall_desc->seg_x2 - solid_wall_desc->seg_x1);
     }
 
     float wall_y1 = H_HEIGHT - solid_wall_desc->world_front_z1 * rw_scale;
@@ -374,10 +1024,19 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
 
     float wall_y2 = H_HEIGHT - solid_wall_desc->world_front_z2 * rw_scale;
     float wall_y2_step = -rw_scale_step * solid_wall_desc->world_front_z2;
+
+    visplane_t *ceil_plane = solid_wall_desc->draw_ceil ? r_find_plane(strip, solid_wall_desc->ceil_texture, solid_wall_desc->ceil_is_sky, solid_wall_desc->world_front_z1, solid_wall_desc->light_level) : NULL;
+    visplane_t *floor_plane = solid_wall_desc->draw_floor ? r_find_plane(strip, solid_wall_desc->floor_texture, solid_wall_desc->floor_is_sky, solid_wall_desc->world_front_z2, solid_wall_desc->light_level) : NULL;
     
-    for (int16_t x = solid_wall_desc->x1; x <= solid_wall_desc->x2; x++)
+    for (int16_t x = solid_wall_desc->seg_x1; x <= solid_wall_desc->x2 && x <= strip->x_end; x++)
     {
-        float depth = solid_wall_desc->rw_distance / cosf(solid_wall_desc->rw_normal_angle - renderer.x_to_angle[x] - renderer.camera_angle);
+        if (x < strip->x_start || x < solid_wall_desc->x1)
+        {
+            rw_scale += rw_scale_step;
+            wall_y1 += wall_y1_step;
+            wall_y2 += wall_y2_step;
+            continue;
+        }
 
         float draw_wall_y1 = wall_y1 - 1;
 
@@ -385,7 +1044,7 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
         {
             int16_t cy1 = renderer.upper_clip[x] + 1;
             int16_t cy2 = (int16_t)(fmin(draw_wall_y1 - 1, renderer.lower_clip[x] - 1));
-            r_draw_flat(solid_wall_desc->ceil_texture, x, cy1, cy2, solid_wall_desc->world_front_z1, solid_wall_desc->light_level);
+            ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
         }
 
         if (solid_wall_desc->draw_wall && x < solid_wall_desc->x2)
@@ -395,6 +1054,9 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
 
             if (wy1 < wy2)
             {
+                if (solid_wall_desc->wall_texture != NULL)
+                    r_unmark_plane(ceil_plane, x, wy1, wy2);
+
                 float angle = solid_wall_desc->rw_center_angle - renderer.x_to_angle[x];
                 float texture_column = solid_wall_desc->rw_distance * tanf(angle) - solid_wall_desc->rw_offset;
                 float inv_scale = 1.0f / rw_scale;
@@ -403,8 +1065,7 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
                     x, wy1, wy2, 
                     solid_wall_desc->middle_texture_alt, 
                     inv_scale,
-                    solid_wall_desc->light_level,
-                    depth
+                    r_get_light_colormap(solid_wall_desc->light_level, rw_scale)
                 );
             }
         }
@@ -413,7 +1074,7 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
         {
             int16_t fy1 = (int16_t)(fmax(wall_y2 + 1, renderer.upper_clip[x] + 1));
             int16_t fy2 = renderer.lower_clip[x] - 1;
-            r_draw_flat(solid_wall_desc->floor_texture, x, fy1, fy2, solid_wall_desc->world_front_z2, solid_wall_desc->light_level);
+            floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
         }
 
         rw_scale += rw_scale_step;
@@ -422,57 +1083,520 @@ void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc)
     }
 }
 
-void r_draw_sprite(int16_t x, int16_t z, image_t *sprite, float rw_scale, float rw_distance)
+static float r_unclamped_scale(int16_t x, float normal_angle, float distance)
+{
+    float x_angle = renderer.x_to_angle[x];
+    float num = renderer.screen_dist * cosf(normal_angle - x_angle - renderer.camera_angle);
+    float den = distance * cosf(x_angle);
+
+    return num / den;
+}
+
+static const pixel_t *r_get_light_colormap_fixed(int16_t light_level, fixed_t scale)
+{
+    int index = scale >> LIGHT_SCALE_SHIFT;
+    return renderer.colormaps[renderer.scale_light[r_light_index(light_level)][index < MAX_LIGHT_SCALE - 1 ? index : MAX_LIGHT_SCALE - 1]];
+}
+
+// Mesma coluna de r_draw_wall_col, com a linha da textura num acumulador inteiro
+static void r_draw_wall_col_fixed(const image_t *texture, int32_t texture_column, int16_t x, int16_t y1, int16_t y2, fixed_t texture_alt, fixed_t inv_scale, const pixel_t *colormap)
+{
+    if (texture == NULL || y1 >= y2)
+        return;
+
+    int32_t col = texture_column % texture->width;
+    if (col < 0) col += texture->width;
+
+    const uint8_t *source = i_get_column(texture, col);
+    int32_t height = texture->height;
+    fixed_t frac = texture_alt + FIXED_MUL(((fixed_t)y1 << FRACBITS) - CENTER_Y_FRAC, inv_scale);
+
+    pixel_t *dest = renderer.screen_buffer + WIDTH * y1 + x;
+
+    if ((height & (height - 1)) == 0)
+    {
+        // Altura potência de 2: a máscara faz a repetição e o acumulador pode dar a volta
+        uint32_t mask = height - 1;
+        uint32_t ufrac = (uint32_t)frac;
+        for (int16_t y = y1; y <= y2; y++)
+        {
+            *dest = colormap[source[(ufrac >> FRACBITS) & mask]];
+            ufrac += (uint32_t)inv_scale;
+            dest += WIDTH;
+        }
+        return;
+    }
+
+    fixed_t limit = height << FRACBITS;
+    fixed_t step = inv_scale % limit;
+    frac %= limit;
+    if (frac < 0) frac += limit;
+
+    for (int16_t y = y1; y <= y2; y++)
+    {
+        *dest = colormap[source[frac >> FRACBITS]];
+        frac += step;
+        if (frac >= limit) frac -= limit;
+        dest += WIDTH;
+    }
+}
+
+// Os cossenos e tangentes ficam nas pontas da parede; o resto é interpolado
+static wall_steps_t r_create_wall_steps(int16_t x1, int16_t x2, float normal_angle, float distance, float center_angle, float offset)
+{
+    wall_steps_t steps = {0};
+
+    float scale1 = r_scale_from_global_angle(x1, normal_angle, distance);
+    double u_scale1 = r_unclamped_scale(x1, normal_angle, distance);
+    double u_scaled1 = (distance * tanf(center_angle - renderer.x_to_angle[x1]) - offset) * u_scale1;
+    steps.scale = FLOAT_TO_FIXED(scale1);
+    steps.u_scale = (int64_t)(u_scale1 * FRACUNIT);
+    steps.u_scaled = (int64_t)(u_scaled1 * FRACUNIT);
+
+    if (x1 < x2)
+    {
+        float scale2 = r_scale_from_global_angle(x2, normal_angle, distance);
+        double u_scale2 = r_unclamped_scale(x2, normal_angle, distance);
+        double u_scaled2 = (distance * tanf(center_angle - renderer.x_to_angle[x2]) - offset) * u_scale2;
+        steps.scale_step = FLOAT_TO_FIXED((scale2 - scale1) / (x2 - x1));
+        steps.u_scale_step = (int64_t)((u_scale2 - u_scale1) / (x2 - x1) * FRACUNIT);
+        steps.u_scaled_step = (int64_t)((u_scaled2 - u_scaled1) / (x2 - x1) * FRACUNIT);
+    }
+
+    return steps;
+}
+
+static void r_advance_wall_steps(wall_steps_t *steps, int32_t count)
+{
+    steps->scale += steps->scale_step * count;
+    steps->u_scale += steps->u_scale_step * count;
+    steps->u_scaled += steps->u_scaled_step * count;
+}
+
+static wall_edge_t r_create_wall_edge(float world_z, const wall_steps_t *steps)
+{
+    fixed_t z = (fixed_t)(world_z * HEIGHTUNIT);
+    return (wall_edge_t) { CENTER_Y_HEIGHT - FIXED_MUL(z, steps->scale), -FIXED_MUL(z, steps->scale_step) };
+}
+
+// A escala interpolada pode passar um pouco do mínimo nas paredes muito distantes
+static fixed_t r_clamp_fixed_scale(fixed_t scale)
+{
+    return scale > MIN_FIXED_SCALE ? scale : MIN_FIXED_SCALE;
+}
+
+static int32_t r_get_texture_column(const wall_steps_t *steps)
+{
+    return (int32_t)(steps->u_scaled / (steps->u_scale > MIN_FIXED_SCALE ? steps->u_scale : MIN_FIXED_SCALE));
+}
+
+static void r_draw_portal_wall_range_fixed(render_strip_t *strip, portal_wall_desc_t *portal_wall_desc)
+{
+    wall_steps_t steps = r_create_wall_steps(portal_wall_desc->seg_x1, portal_wall_desc->seg_x2, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance, portal_wall_desc->rw_center_angle, portal_wall_desc->rw_offset);
+    wall_edge_t top = r_create_wall_edge(portal_wall_desc->world_front_z1, &steps);
+    wall_edge_t bottom = r_create_wall_edge(portal_wall_desc->world_front_z2, &steps);
+
+    visplane_t *ceil_plane = portal_wall_desc->draw_ceil ? r_find_plane(strip, portal_wall_desc->ceil_texture, portal_wall_desc->ceil_is_sky, portal_wall_desc->world_front_z1, portal_wall_desc->light_level) : NULL;
+    visplane_t *floor_plane = portal_wall_desc->draw_floor ? r_find_plane(strip, portal_wall_desc->floor_texture, portal_wall_desc->floor_is_sky, portal_wall_desc->world_front_z2, portal_wall_desc->light_level) : NULL;
+
+    wall_edge_t portal_top = bottom;
+    wall_edge_t portal_bottom = top;
+
+    if (portal_wall_desc->draw_upper_wall && portal_wall_desc->world_back_z1 > portal_wall_desc->world_front_z2)
+        portal_top = r_create_wall_edge(portal_wall_desc->world_back_z1, &steps);
+
+    if (portal_wall_desc->draw_lower_wall && portal_wall_desc->world_back_z2 < portal_wall_desc->world_front_z1)
+        portal_bottom = r_create_wall_edge(portal_wall_desc->world_back_z2, &steps);
+
+    fixed_t upper_tex_alt = FLOAT_TO_FIXED(portal_wall_desc->upper_tex_alt);
+    fixed_t lower_tex_alt = FLOAT_TO_FIXED(portal_wall_desc->lower_tex_alt);
+
+    // Colunas recortadas ou de outras faixas: os passos são inteiros, então pular direto dá os mesmos valores
+    int16_t x = MAX(portal_wall_desc->x1, strip->x_start);
+    int32_t skip = x - portal_wall_desc->seg_x1;
+    if (skip > 0)
+    {
+        r_advance_wall_steps(&steps, skip);
+        top.frac += top.step * skip;
+        bottom.frac += bottom.step * skip;
+        if (portal_wall_desc->draw_upper_wall) portal_top.frac += portal_top.step * skip;
+        if (portal_wall_desc->draw_lower_wall) portal_bottom.frac += portal_bottom.step * skip;
+    }
+
+    int32_t texture_column = 0;
+    fixed_t inv_scale = 0;
+    const pixel_t *colormap = NULL;
+    for (; x < portal_wall_desc->x2 && x <= strip->x_end; x++)
+    {
+        fixed_t scale = r_clamp_fixed_scale(steps.scale);
+        int16_t wall_y1 = top.frac >> HEIGHTBITS;
+        int16_t wall_y2 = bottom.frac >> HEIGHTBITS;
+
+        if (portal_wall_desc->draw_upper_wall || portal_wall_desc->draw_lower_wall)
+        {
+            inv_scale = FIXED_DIV(FRACUNIT, scale);
+            texture_column = r_get_texture_column(&steps);
+            colormap = r_get_light_colormap_fixed(portal_wall_desc->light_level, scale);
+        }
+
+        if (portal_wall_desc->draw_upper_wall)
+        {
+            if (portal_wall_desc->draw_ceil)
+            {
+                int16_t cy1 = renderer.upper_clip[x] + 1;
+                int16_t cy2 = MIN(wall_y1 - 2, renderer.lower_clip[x] - 1);
+                ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
+            }
+
+            int16_t wy1 = MAX(wall_y1 - 1, renderer.upper_clip[x] + 1);
+            int16_t wy2 = MIN(portal_top.frac >> HEIGHTBITS, renderer.lower_clip[x] - 1);
+            if (portal_wall_desc->upper_wall_texture != NULL && wy1 < wy2)
+                r_unmark_plane(ceil_plane, x, wy1, wy2);
+            r_draw_wall_col_fixed(portal_wall_desc->upper_wall_texture, texture_column, x, wy1, wy2, upper_tex_alt, inv_scale, colormap);
+
+            if (renderer.upper_clip[x] < wy2)
+                renderer.upper_clip[x] = wy2;
+
+            portal_top.frac += portal_top.step;
+        }
+
+        if (portal_wall_desc->draw_ceil)
+        {
+            int16_t cy1 = renderer.upper_clip[x] + 1;
+            int16_t cy2 = MIN(wall_y1 - 2, renderer.lower_clip[x] - 1);
+            ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
+
+            if (renderer.upper_clip[x] < cy2)
+                renderer.upper_clip[x] = cy2;
+        }
+
+        if (portal_wall_desc->draw_lower_wall)
+        {
+            if (portal_wall_desc->draw_floor)
+            {
+                int16_t fy1 = MAX(wall_y2 + 1, renderer.upper_clip[x] + 1);
+                int16_t fy2 = renderer.lower_clip[x] - 1;
+                floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
+            }
+
+            int16_t wy1 = MAX((portal_bottom.frac >> HEIGHTBITS) - 1, renderer.upper_clip[x] + 1);
+            int16_t wy2 = MIN(wall_y2, renderer.lower_clip[x] - 1);
+            if (portal_wall_desc->lower_wall_texture != NULL && wy1 < wy2)
+                r_unmark_plane(floor_plane, x, wy1, wy2);
+            r_draw_wall_col_fixed(portal_wall_desc->lower_wall_texture, texture_column, x, wy1, wy2, lower_tex_alt, inv_scale, colormap);
+
+            if (renderer.lower_clip[x] > wy1)
+                renderer.lower_clip[x] = wy1;
+
+            portal_bottom.frac += portal_bottom.step;
+        }
+
+        if (portal_wall_desc->draw_floor)
+        {
+            int16_t fy1 = MAX(wall_y2 + 1, renderer.upper_clip[x] + 1);
+            int16_t fy2 = renderer.lower_clip[x] - 1;
+            floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
+
+            if (renderer.lower_clip[x] > wall_y2 + 1)
+                renderer.lower_clip[x] = fy1;
+        }
+
+        r_advance_wall_steps(&steps, 1);
+        top.frac += top.step;
+        bottom.frac += bottom.step;
+    }
+}
+
+static void r_draw_solid_wall_range_fixed(render_strip_t *strip, solid_wall_desc_t *solid_wall_desc)
+{
+    wall_steps_t steps = r_create_wall_steps(solid_wall_desc->seg_x1, solid_wall_desc->seg_x2, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance, solid_wall_desc->rw_center_angle, solid_wall_desc->rw_offset);
+    wall_edge_t top = r_create_wall_edge(solid_wall_desc->world_front_z1, &steps);
+    wall_edge_t bottom = r_create_wall_edge(solid_wall_desc->world_front_z2, &steps);
+
+    visplane_t *ceil_plane = solid_wall_desc->draw_ceil ? r_find_plane(strip, solid_wall_desc->ceil_texture, solid_wall_desc->ceil_is_sky, solid_wall_desc->world_front_z1, solid_wall_desc->light_level) : NULL;
+    visplane_t *floor_plane = solid_wall_desc->draw_floor ? r_find_plane(strip, solid_wall_desc->floor_texture, solid_wall_desc->floor_is_sky, solid_wall_desc->world_front_z2, solid_wall_desc->light_level) : NULL;
+
+    fixed_t texture_alt = FLOAT_TO_FIXED(solid_wall_desc->middle_texture_alt);
+
+    int16_t x = MAX(solid_wall_desc->x1, strip->x_start);
+    int32_t skip = x - solid_wall_desc->seg_x1;
+    if (skip > 0)
+    {
+        r_advance_wall_steps(&steps, skip);
+        top.frac += top.step * skip;
+        bottom.frac += bottom.step * skip;
+    }
+
+    for (; x <= solid_wall_desc->x2 && x <= strip->x_end; x++)
+    {
+        int16_t wall_y1 = top.frac >> HEIGHTBITS;
+        int16_t wall_y2 = bottom.frac >> HEIGHTBITS;
+
+        if (solid_wall_desc->draw_ceil)
+        {
+            int16_t cy1 = renderer.upper_clip[x] + 1;
+            int16_t cy2 = MIN(wall_y1 - 2, renderer.lower_clip[x] - 1);
+            ceil_plane = r_mark_plane(strip, ceil_plane, x, cy1, cy2);
+        }
+
+        if (solid_wall_desc->draw_wall && x < solid_wall_desc->x2)
+        {
+            int16_t wy1 = MAX(wall_y1 - 1, renderer.upper_clip[x] + 1);
+            int16_t wy2 = MIN(wall_y2, renderer.lower_clip[x] - 1);
+
+            if (wy1 < wy2)
+            {
+                if (solid_wall_desc->wall_texture != NULL)
+                    r_unmark_plane(ceil_plane, x, wy1, wy2);
+
+                fixed_t scale = r_clamp_fixed_scale(steps.scale);
+                fixed_t inv_scale = FIXED_DIV(FRACUNIT, scale);
+                r_draw_wall_col_fixed(solid_wall_desc->wall_texture,
+                    r_get_texture_column(&steps),
+                    x, wy1, wy2,
+                    texture_alt,
+                    inv_scale,
+                    r_get_light_colormap_fixed(solid_wall_desc->light_level, scale)
+                );
+            }
+        }
+
+        if (solid_wall_desc->draw_floor)
+        {
+            int16_t fy1 = MAX(wall_y2 + 1, renderer.upper_clip[x] + 1);
+            int16_t fy2 = renderer.lower_clip[x] - 1;
+            floor_plane = r_mark_plane(strip, floor_plane, x, fy1, fy2);
+        }
+
+        r_advance_wall_steps(&steps, 1);
+        top.frac += top.step;
+        bottom.frac += bottom.step;
+    }
+}
+
+void r_draw_portal_wall_range(render_strip_t *strip, portal_wall_desc_t *portal_wall_desc)
+{
+    if (renderer.fixed_point_walls)
+        r_draw_portal_wall_range_fixed(strip, portal_wall_desc);
+    else
+        r_draw_portal_wall_range_float(strip, portal_wall_desc);
+
+    // Um degrau na frente ou o outro setor acima/abaixo dos olhos esconde o que está atrás; uma porta fechada esconde tudo
+    bool closed = portal_wall_desc->world_back_z1 <= portal_wall_desc->world_front_z2 || portal_wall_desc->world_back_z2 >= portal_wall_desc->world_front_z1;
+    // As escalas são as das pontas do seg, então o teste contra os sprites é o mesmo em qualquer faixa
+    r_store_drawseg(strip, portal_wall_desc->x1, portal_wall_desc->x2 - 1,
+        r_scale_from_global_angle(portal_wall_desc->seg_x1, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance),
+        r_scale_from_global_angle(portal_wall_desc->seg_x2, portal_wall_desc->rw_normal_angle, portal_wall_desc->rw_distance),
+        portal_wall_desc->seg_start, portal_wall_desc->seg_end, false,
+        closed || portal_wall_desc->world_front_z1 < portal_wall_desc->world_back_z1 || portal_wall_desc->world_back_z1 < 0,
+        closed || portal_wall_desc->world_front_z2 > portal_wall_desc->world_back_z2 || portal_wall_desc->world_back_z2 > 0);
+}
+
+void r_draw_solid_wall_range(render_strip_t *strip, solid_wall_desc_t *solid_wall_desc)
+{
+    if (renderer.fixed_point_walls)
+        r_draw_solid_wall_range_fixed(strip, solid_wall_desc);
+    else
+        r_draw_solid_wall_range_float(strip, solid_wall_desc);
+
+    r_store_drawseg(strip, solid_wall_desc->x1, solid_wall_desc->x2 - 1,
+        r_scale_from_global_angle(solid_wall_desc->seg_x1, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance),
+        r_scale_from_global_angle(solid_wall_desc->seg_x2, solid_wall_desc->rw_normal_angle, solid_wall_desc->rw_distance),
+        solid_wall_desc->seg_start, solid_wall_desc->seg_end, true, true, true);
+}
+
+void r_set_fixed_point_walls(bool enabled)
+{
+    renderer.fixed_point_walls = enabled;
+}
+
+bool r_get_fixed_point_walls()
+{
+    return renderer.fixed_point_walls;
+}
+
+// A parede fica atrás do sprite quando ele está do mesmo lado da linha que a câmera
+static bool r_is_sprite_in_front(const drawseg_t *drawseg, vertex_t position)
+{
+    float dx = drawseg->seg_end.x - drawseg->seg_start.x;
+    float dy = drawseg->seg_end.y - drawseg->seg_start.y;
+    float sprite_side = dx * (position.y - drawseg->seg_start.y) - dy * (position.x - drawseg->seg_start.x);
+    float camera_side = dx * (renderer.camera_pos.y - drawseg->seg_start.y) - dy * (renderer.camera_pos.x - drawseg->seg_start.x);
+    return (sprite_side > 0) == (camera_side > 0);
+}
+
+void r_draw_sprite(render_strip_t *strip, float x, int16_t z, const image_t *sprite, float rw_scale, vertex_t position, int16_t light_level)
 {
-    float sprite_screen_height = sprite->height * rw_scale;
+    if (sprite->data == NULL) return;
+
     float sprite_screen_width = sprite->width * rw_scale;
     float y_offset = H_HEIGHT - (z + sprite->top_offset) * rw_scale;
     float x_offset = x - sprite_screen_width / 2;
 
-    if (x_offset < 0 || x_offset + sprite_screen_width > WIDTH || y_offset < 0 || y_offset + sprite_screen_height > HEIGHT || sprite->data == NULL) return;
+    // O sprite pode passar das bordas da tela: só as colunas e linhas visíveis são percorridas.
+    // Os limites ficam em 32 bits porque um sprite muito perto da câmera passa do alcance de int16_t
+    int32_t screen_x = (int32_t)floorf(x_offset);
+    int32_t screen_y = (int32_t)floorf(y_offset);
+    int32_t columns = (int32_t)ceilf(sprite_screen_width);
+    int32_t rows = (int32_t)ceilf(sprite->height * rw_scale);
+
+    int16_t x1 = (int16_t)MAX(screen_x, (int32_t)strip->x_start);
+    int16_t x2 = (int16_t)MIN(screen_x + columns - 1, (int32_t)strip->x_end);
+    if (x1 > x2) return;
+
+    int16_t *top_clip = ar_alloc(&strip->arena, 2 * (x2 - x1 + 1) * sizeof(int16_t), 8);
+    if (top_clip == NULL) return;
+    int16_t *bottom_clip = top_clip + (x2 - x1 + 1);
+    for (int16_t i = 0; i <= x2 - x1; i++)
+        top_clip[i] = bottom_clip[i] = -2;
+
+    // Do último drawseg para o primeiro: os mais distantes guardaram os limites já somados aos das paredes da frente
+    for (const drawseg_t *drawseg = strip->drawsegs; drawseg != NULL; drawseg = drawseg->next)
+    {
+        if (drawseg->x1 > x2 || drawseg->x2 < x1) continue;
+
+        float low_scale = drawseg->scale1 < drawseg->scale2 ? drawseg->scale1 : drawseg->scale2;
+        float high_scale = drawseg->scale1 < drawseg->scale2 ? drawseg->scale2 : drawseg->scale1;
+        if (high_scale < rw_scale || (low_scale < rw_scale && r_is_sprite_in_front(drawseg, position)))
+            continue;
+
+        int16_t r1 = drawseg->x1 > x1 ? drawseg->x1 : x1;
+        int16_t r2 = drawseg->x2 < x2 ? drawseg->x2 : x2;
+        for (int16_t c = r1; c <= r2; c++)
+        {
+            if (top_clip[c - x1] == -2 && (drawseg->solid || drawseg->top_clip != NULL))
+                top_clip[c - x1] = drawseg->solid ? HEIGHT : drawseg->top_clip[c];
+            if (bottom_clip[c - x1] == -2 && (drawseg->solid || drawseg->bottom_clip != NULL))
+                bottom_clip[c - x1] = drawseg->solid ? -1 : drawseg->bottom_clip[c];
+        }
+    }
+
+    // Um colormap fixo para o sprite inteiro, pela luz do setor e pela escala
+    const pixel_t *colormap = r_get_light_colormap(light_level, rw_scale);
+    const uint8_t *mask = i_get_mask(sprite);
+
+    // Um texel do sprite por 1/rw_scale pixels da tela, nas duas direções; o passo truncado
+    // mantém o último texel dentro da imagem
+    fixed_t inv_scale = FLOAT_TO_FIXED(1.f / rw_scale);
 
-    for (int16_t x = 0; x < sprite_screen_width; x++) 
+    for (int16_t c = x1; c <= x2; c++)
     {
-        for (int16_t y = 0; y < sprite_screen_height; y++)
+        int32_t top = top_clip[c - x1] == -2 ? -1 : top_clip[c - x1];
+        int32_t bottom = bottom_clip[c - x1] == -2 ? HEIGHT : bottom_clip[c - x1];
+
+        int32_t y1 = MAX(top + 1, 0) - screen_y;
+        int32_t y2 = MIN(bottom - 1, HEIGHT - 1) - screen_y;
+        y1 = MAX(y1, 0);
+        y2 = MIN(y2, rows - 1);
+        if (y1 > y2) continue;
+
+        // Mapeia para o espaço do sprite original
+        int32_t tex_x = (int32_t)(((int64_t)(c - screen_x) * inv_scale) >> FRACBITS);
+        const uint8_t *column = sprite->data + tex_x;
+        const uint8_t *column_mask = mask != NULL ? mask + tex_x : NULL;
+
+        int64_t frac = (int64_t)y1 * inv_scale;
+        pixel_t *dest = &renderer.screen_buffer[(screen_y + y1) * WIDTH + c];
+        for (int32_t y = y1; y <= y2; y++, frac += inv_scale, dest += WIDTH)
         {
-            uint32_t i = (uint32_t)(y_offset + y) * WIDTH + (uint32_t)(x_offset + x);
-            if (rw_distance > renderer.depth_buffer[i])
-                continue;
+            uint32_t texel = (uint32_t)(frac >> FRACBITS) * sprite->width;
+            if (column_mask == NULL || column_mask[texel])
+                *dest = colormap[column[texel]];
+        }
+    }
+}
+
+void r_present(uint8_t index)
+{
+    renderer.presented_frame = index < renderer.frame_count ? index : 0;
+    if (renderer.headless)
+        return;
+
+    // O frame pode ter sido desenhado em outra resolução (ainda estava no pipeline quando ela mudou): só
+    // o canto da textura com o tamanho dele é atualizado e esticado para a janela
+    const frame_buffer_t *frame = &renderer.frames[renderer.presented_frame];
+    SDL_Rect source = { 0, 0, frame->width, frame->height };
+#ifdef R_INDEXED_COLOR
+    // Única conversão para RGBA do frame
+    renderer.expand(frame->pixels, renderer.present_buffer, frame->width * frame->height, frame->palette);
+    SDL_UpdateTexture(renderer.screen_texture, &source, renderer.present_buffer, frame->width * sizeof(uint32_t));
+#else
+    SDL_UpdateTexture(renderer.screen_texture, &source, frame->pixels, frame->width * sizeof(uint32_t));
+#endif
+    SDL_RenderCopy(renderer.handler, renderer.screen_texture, &source, NULL);
+    SDL_RenderPresent(renderer.handler);
+}
+
+void r_read_frame(uint32_t *rgba)
+{
+    const frame_buffer_t *frame = &renderer.frames[renderer.presented_frame];
+#ifdef R_INDEXED_COLOR
+    renderer.expand(frame->pixels, rgba, frame->width * frame->height, frame->palette);
+#else
+    memcpy(rgba, frame->pixels, frame->width * frame->height * sizeof(uint32_t));
+#endif
+}
 
-            // Mapeia para o espaço do sprite original
-            int16_t tex_x = (x * sprite->width) / sprite_screen_width;
-            int16_t tex_y = (y * sprite->height) / sprite_screen_height;
+bool r_write_ppm(const char *path)
+{
+    uint16_t width = renderer.frames[renderer.presented_frame].width;
+    uint16_t height = renderer.frames[renderer.presented_frame].height;
+    uint32_t *rgba = malloc(width * height * sizeof(uint32_t));
+    uint8_t *row = malloc(width * 3);
+    FILE *file = fopen(path, "wb");
+    bool written = rgba != NULL && row != NULL && file != NULL;
+
+    if (written)
+    {
+        r_read_frame(rgba);
+        written = fprintf(file, "P6\n%u %u\n255\n", width, height) > 0;
 
-            uint32_t color = sprite->data[tex_y * sprite->width + tex_x];
-            if (color != 0x00)
-                renderer.screen_buffer[i] = color;
+        // RGBA32 guarda o vermelho no byte baixo
+        for (uint16_t y = 0; written && y < height; y++)
+        {
+            const uint32_t *src = &rgba[y * width];
+            for (uint16_t x = 0; x < width; x++)
+            {
+                row[x * 3 + 0] = src[x] & 0xFF;
+                row[x * 3 + 1] = (src[x] >> 8) & 0xFF;
+                row[x * 3 + 2] = (src[x] >> 16) & 0xFF;
+            }
+
+            written = fwrite(row, 3, width, file) == width;
         }
     }
+
+    if (file != NULL && fclose(file) != 0)
+        written = false;
+
+    if (!written)
+    {
+        DOOM_LOG_ERROR("Nao foi possivel gravar o frame em %s", path);
+    }
+
+    free(rgba);
+    free(row);
+    return written;
 }
 
 void r_end_draw()
 {
-    SDL_UpdateTexture(renderer.screen_texture, NULL, renderer.screen_buffer, WIDTH * sizeof(uint32_t));
-    SDL_RenderCopy(renderer.handler, renderer.screen_texture, NULL, NULL);
-    SDL_RenderPresent(renderer.handler);
+    r_present(renderer.draw_frame);
 }
 
-int16_t r_angle_to_x(float angle)
+int16_t r_view_angle_to_x(angle_t angle)
 {
-    return (angle > 0) ? (int16_t)(renderer.screen_dist - tanf(angle) * H_WIDTH) 
-                                        : 
-                        (int16_t)(-tanf(angle) * H_WIDTH + renderer.screen_dist);
+    return renderer.view_angle_to_x[((angle + ANG90) >> ANGLETOFINESHIFT) & (FINEANGLES / 2 - 1)];
 }
 
 float r_scale_from_global_angle(int16_t x, float normal_angle, float distance)
 {
-    float x_angle = renderer.x_to_angle[x];
-    float num = renderer.screen_dist * cosf(normal_angle - x_angle - renderer.camera_angle);
-    float den = distance * cosf(x_angle);
+    return fmin(MAX_SCALE, fmax(MIN_SCALE, r_unclamped_scale(x, normal_angle, distance)));
+}
 
-    float scale = num / den;
-    scale = fmin(MAX_SCALE, fmax(MIN_SCALE, scale));
-    return scale;
+arena_t *r_get_frame_arena()
+{
+    return &renderer.frame_arena;
 }
 
 uint16_t r_get_width()
@@ -485,16 +1609,24 @@ uint16_t r_get_height()
     return HEIGHT;
 }
 
+float r_get_screen_dist()
+{
+    return renderer.screen_dist;
+}
+
 void r_shutdown()
 {
     if (initialized)
     {
-        SDL_DestroyTexture(renderer.screen_texture);
-        free(renderer.screen_buffer);
+        if (!renderer.headless)
+            SDL_DestroyTexture(renderer.screen_texture);
+        r_delete_buffers();
         free(renderer.x_to_angle);
         free(renderer.upper_clip);
         free(renderer.lower_clip);
-        free(renderer.depth_buffer);
-        SDL_DestroyRenderer(renderer.handler);
+        r_delete_strips();
+        ar_destroy(&renderer.frame_arena);
+        if (!renderer.headless)
+            SDL_DestroyRenderer(renderer.handler);
     }
 }
\ No newline at end of file
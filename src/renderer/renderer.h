@@ -4,19 +4,46 @@
 #include "typedefs.h"
 #include "../core/player.h"
 #include "assets/asset.h"
+#include "core/arena.h"
 
 #define FOV PI_2
 #define H_FOV PI_4
+#define GAMMA_LEVELS 5
+#define MAX_FRAME_BUFFERS 3
+
+// Com R_INDEXED_COLOR (make INDEXED=1) o frame é desenhado em índices da paleta e só vira RGBA
+// no r_end_draw; sem ele cada pixel já é escrito em RGBA
+#ifdef R_INDEXED_COLOR
+typedef uint8_t pixel_t;
+#else
+typedef uint32_t pixel_t;
+#endif
+
+// Faixa vertical da tela [x_start, x_end] desenhada por um thread: cada uma tem seus planos,
+// sua memória de rascunho e o início dos spans por linha. Com uma faixa só, é a tela inteira
+typedef struct _render_strip
+{
+    int16_t x_start, x_end;
+    arena_t arena;
+    struct _visplane *planes;
+    struct _drawseg *drawsegs;
+    int16_t *span_start;
+} render_strip_t;
 
 typedef struct _portal_wall_desc
 {
     bool draw_upper_wall, draw_lower_wall, draw_ceil, draw_floor;
     int16_t x1, x2, light_level;
+    // Primeira e última coluna do seg antes do recorte: a interpolação parte delas, então o valor de uma
+    // coluna não depende de como o seg foi dividido pelas paredes da frente ou pelas faixas
+    int16_t seg_x1, seg_x2;
     float world_front_z1, world_back_z1, world_front_z2, world_back_z2, rw_normal_angle, rw_distance, upper_tex_alt, lower_tex_alt, rw_offset, rw_center_angle;
-    char *upper_wall_texture;
-    char *lower_wall_texture;
-    char *ceil_texture;
-    char *floor_texture;
+    bool ceil_is_sky, floor_is_sky;
+    vertex_t seg_start, seg_end;
+    const image_t *upper_wall_texture;
+    const image_t *lower_wall_texture;
+    const image_t *ceil_texture;
+    const image_t *floor_texture;
 } portal_wall_desc_t;
 
 
@@ -24,31 +51,74 @@ typedef struct _solid_wall_desc
 {
     bool draw_wall, draw_ceil, draw_floor;
     int16_t x1, x2, light_level;
+    int16_t seg_x1, seg_x2; // Como em portal_wall_desc_t
     float world_front_z1, world_front_z2, rw_normal_angle, rw_distance, middle_texture_alt, rw_offset, rw_center_angle;
-    char *wall_texture;
-    char *ceil_texture;
-    char *floor_texture;
+    bool ceil_is_sky, floor_is_sky;
+    vertex_t seg_start, seg_end;
+    const image_t *wall_texture;
+    const image_t *ceil_texture;
+    const image_t *floor_texture;
 } solid_wall_desc_t;
 
+// scrn_w x scrn_h é a resolução inicial e também a máxima: buffers e tabelas são reservados nesse tamanho
 bool r_init(uint16_t scrn_w, uint16_t scrn_h);
+// Sem janela nem vídeo (servidores e benchmarks): r_present não mostra nada, o frame fica na memória
+bool r_init_headless(uint16_t scrn_w, uint16_t scrn_h);
+// Troca a resolução interna sem alocar, até a máxima do r_init. Só entre frames, no thread que desenha;
+// frames já desenhados continuam sendo apresentados na resolução deles
+bool r_set_resolution(uint16_t width, uint16_t height);
+void r_get_max_resolution(uint16_t *width, uint16_t *height);
 
 void r_begin_draw(const player_t *player);
 
-void r_draw_pixel(int x, int y, uint32_t color);
-void r_draw_vertical_line(int16_t x, int16_t y1, int16_t y2, const char *wall_texture, int16_t light_level, uint32_t color);
-void r_draw_wall_col(const char *texture_name, float texture_column, int16_t x, int16_t y1, int16_t y2, float texture_alt, float inv_scale, int16_t light_level, float depth);
-void r_draw_flat(const char *texture_name, int16_t x, int16_t y1, int16_t y2, float world_z, int16_t light_level);
-void r_draw_portal_wall_range(portal_wall_desc_t *portal_wall_desc);
-void r_draw_solid_wall_range(solid_wall_desc_t *solid_wall_desc);
-void r_draw_sprite(int16_t x, int16_t z, image_t *sprite, float rw_scale, float rw_distance);
+void r_draw_pixel(int x, int y, pixel_t color);
+void r_draw_vertical_line(int16_t x, int16_t y1, int16_t y2, const char *wall_texture, int16_t light_level, pixel_t color);
+void r_draw_wall_col(const image_t *texture, float texture_column, int16_t x, int16_t y1, int16_t y2, float texture_alt, float inv_scale, const pixel_t *colormap);
+void r_draw_portal_wall_range(render_strip_t *strip, portal_wall_desc_t *portal_wall_desc);
+void r_draw_solid_wall_range(render_strip_t *strip, solid_wall_desc_t *solid_wall_desc);
+void r_draw_planes(render_strip_t *strip);
+// Paredes em ponto fixo (padrão) ou no caminho em float, mantido para comparar precisão e tempo
+void r_set_fixed_point_walls(bool enabled);
+bool r_get_fixed_point_walls();
+// Recorta o sprite pelas paredes já desenhadas na faixa que estão na frente dele. x é a coluna do centro
+// do sprite, que pode estar fora da tela; só a parte visível é desenhada
+void r_draw_sprite(render_strip_t *strip, float x, int16_t z, const image_t *sprite, float rw_scale, vertex_t position, int16_t light_level);
 void r_end_draw();
 
-int16_t r_angle_to_x(float angle);
+// Framebuffers do pipeline de frames: um frame é desenhado em r_set_draw_buffer enquanto outro,
+// já pronto, é apresentado por r_present no thread do SDL. r_end_draw apresenta o buffer em desenho
+bool r_set_frame_buffer_count(uint8_t count);
+void r_set_draw_buffer(uint8_t index);
+void r_present(uint8_t index);
+// Último frame apresentado, em RGBA32, na resolução em que foi desenhado (r_get_width() * r_get_height()
+// pixels enquanto a resolução não muda)
+void r_read_frame(uint32_t *rgba);
+bool r_write_ppm(const char *path);
+
+// Colormap (índice -> pixel) para a luz do setor diminuída pela escala na tela
+const pixel_t *r_get_light_colormap(int16_t light_level, float scale);
+const pixel_t *r_get_colormap(uint8_t index);
+
+// Efeitos de paleta: só refazem as tabelas de 256 cores, sem tocar nos pixels
+void r_set_palette(uint8_t palette_index); // 0 normal, 1-8 dano, 9-12 itens, 13 radiação
+void r_set_gamma(uint8_t level);
+
+// Coluna de um ângulo relativo à câmera (positivo à esquerda), dentro de [-90, 90] graus
+int16_t r_view_angle_to_x(angle_t angle);
 float r_scale_from_global_angle(int16_t x, float normal_angle, float distance);
 
 
+// Divide a tela em count faixas verticais, desenhadas em paralelo pelo bsp_render. Numa resolução
+// com menos colunas que faixas, r_get_strip_count devolve só as que estão em uso
+bool r_set_strip_count(uint16_t count);
+uint16_t r_get_strip_count();
+render_strip_t *r_get_strip(uint16_t index);
+
+arena_t *r_get_frame_arena();
 uint16_t r_get_width();
 uint16_t r_get_height();
+// Distância da câmera ao plano de projeção, em pixels
+float r_get_screen_dist();
 
 void r_shutdown();
 
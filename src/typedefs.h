@@ -10,6 +10,26 @@
 #define PI_2 (PI / 2.0f)
 #define PI_4 (PI / 4.0f)
 
+// Ponto fixo 16.16, como no Doom
+typedef int32_t fixed_t;
+#define FRACBITS 16
+#define FRACUNIT (1 << FRACBITS)
+#define FLOAT_TO_FIXED(_f) ((fixed_t)((_f) * FRACUNIT))
+#define FIXED_TO_FLOAT(_f) ((float)(_f) / FRACUNIT)
+#define FIXED_MUL(_a, _b) ((fixed_t)(((int64_t)(_a) * (_b)) >> FRACBITS))
+#define FIXED_DIV(_a, _b) ((fixed_t)(((int64_t)(_a) << FRACBITS) / (_b)))
+
+// Ângulos binários (BAM) de 32 bits: a volta inteira é 2^32, então somas e subtrações já normalizam
+typedef uint32_t angle_t;
+#define ANG45 0x20000000u
+#define ANG90 0x40000000u
+#define ANG180 0x80000000u
+#define ANG270 0xC0000000u
+#define FINEANGLES 8192
+#define FINEMASK (FINEANGLES - 1)
+#define ANGLETOFINESHIFT 19
+#define SLOPERANGE 2048
+
 typedef struct _vec2i
 {
     int x, y;
@@ -106,14 +126,6 @@ typedef struct _palette
     unsigned char r, g, b;
 } palette_t;
 
-typedef struct _patch_colum
-{
-    uint8_t top_delta, length;
-    uint8_t padding_pre; // unused
-    uint8_t *data; // size_bytes = length
-    uint8_t padding_post; // unused
-} patch_colum_t;
-
 typedef struct _patch_header
 {
     uint16_t width, height;
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include <math.h>
+#include <stdlib.h>
 
 float u_magnitude_vec(float x, float y, float z)
 {
@@ -35,4 +36,99 @@ float u_normalize_angle(float angle)
 {
     angle = fmodf(angle, 2 * PI);
     return angle >= 0 ? angle : angle + 2 * PI;
-}
\ No newline at end of file
+}
+
+static float fine_sine[FINEANGLES + FINEANGLES / 4]; // O cosseno é o seno adiantado de 90 graus
+static float fine_tangent[FINEANGLES / 2];
+static angle_t tan_to_angle[SLOPERANGE + 1];
+static bool trig_tables_ready = false;
+
+void u_init_trig_tables()
+{
+    if (trig_tables_ready) return;
+
+    for (uint32_t i = 0; i < FINEANGLES + FINEANGLES / 4; i++)
+        fine_sine[i] = (float)sin((i + 0.5) * 2 * PI / FINEANGLES);
+
+    // Cada índice começa em -90 graus, assim +-45 graus caem exatamente no início de um índice
+    for (uint32_t i = 0; i < FINEANGLES / 2; i++)
+        fine_tangent[i] = (float)tan(((double)i - FINEANGLES / 4) * 2 * PI / FINEANGLES);
+
+    for (uint32_t i = 0; i <= SLOPERANGE; i++)
+        tan_to_angle[i] = (angle_t)(atan((double)i / SLOPERANGE) / (2 * PI) * 4294967296.0);
+
+    trig_tables_ready = true;
+}
+
+float u_fine_sine(angle_t angle)
+{
+    return fine_sine[angle >> ANGLETOFINESHIFT];
+}
+
+float u_fine_cosine(angle_t angle)
+{
+    return fine_sine[(angle >> ANGLETOFINESHIFT) + FINEANGLES / 4];
+}
+
+float u_fine_tangent(angle_t angle)
+{
+    return fine_tangent[((angle + ANG90) >> ANGLETOFINESHIFT) & (FINEANGLES / 2 - 1)];
+}
+
+static uint32_t u_slope_div(uint32_t num, uint32_t den)
+{
+    if (den == 0) return SLOPERANGE;
+    uint32_t slope = (num * SLOPERANGE) / den;
+    return slope <= SLOPERANGE ? slope : SLOPERANGE;
+}
+
+// Ângulo de (dx, dy) pelo octante e pela tabela de arco tangente, sem atan2
+angle_t u_point_to_angle(int32_t dx, int32_t dy)
+{
+    if (dx == 0 && dy == 0) return 0;
+
+    if (dx >= 0)
+    {
+        if (dy >= 0)
+            return dx > dy ? tan_to_angle[u_slope_div(dy, dx)] : ANG90 - 1 - tan_to_angle[u_slope_div(dx, dy)];
+
+        dy = -dy;
+        return dx > dy ? -tan_to_angle[u_slope_div(dy, dx)] : ANG270 + tan_to_angle[u_slope_div(dx, dy)];
+    }
+
+    dx = -dx;
+    if (dy >= 0)
+        return dx > dy ? ANG180 - 1 - tan_to_angle[u_slope_div(dy, dx)] : ANG90 + tan_to_angle[u_slope_div(dx, dy)];
+
+    dy = -dy;
+    return dx > dy ? ANG180 + tan_to_angle[u_slope_div(dy, dx)] : ANG270 - 1 - tan_to_angle[u_slope_div(dx, dy)];
+}
+
+angle_t u_radians_to_bam(float radians)
+{
+    return (angle_t)(int64_t)(u_normalize_angle(radians) / (2 * PI) * 4294967296.0);
+}
+
+float u_bam_to_radians(angle_t angle)
+{
+    return angle * (2 * PI / 4294967296.0f);
+}
+
+angle_t u_convert_bams(int16_t bams)
+{
+    return (angle_t)(uint16_t)bams << 16;
+}
+
+size_t u_parse_size(const char *text)
+{
+    char *end = NULL;
+    size_t size = strtoull(text, &end, 10);
+
+    switch (end != NULL ? *end : '\0')
+    {
+    case 'k': case 'K': return size << 10;
+    case 'm': case 'M': return size << 20;
+    case 'g': case 'G': return size << 30;
+    default: return size;
+    }
+}
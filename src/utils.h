@@ -10,4 +10,17 @@ vec2f_t u_rotate_vec2f(vec2f_t vec, float angle);
 float u_convert_bams_to_radians(int16_t bams);
 float u_convert_degrees_to_radians(int16_t angle);
 float u_normalize_angle(float angle);
+
+// Tabelas de seno e tangente por ângulo fino (FINEANGLES por volta) e de arco tangente por inclinação,
+// como no Doom; criadas uma vez, antes de qualquer uso
+void u_init_trig_tables();
+float u_fine_sine(angle_t angle);
+float u_fine_cosine(angle_t angle);
+float u_fine_tangent(angle_t angle); // Só para ângulos em (-90, 90) graus
+angle_t u_point_to_angle(int32_t dx, int32_t dy);
+angle_t u_radians_to_bam(float radians);
+float u_bam_to_radians(angle_t angle);
+angle_t u_convert_bams(int16_t bams); // BAM de 16 bits do WAD
+
+size_t u_parse_size(const char *text);
 #endif
\ No newline at end of file
@@ -1,68 +1,131 @@
 #include "file_hash.h"
 #include <string.h>
 
-static uint32_t fh_hash_function(const char *key, uint32_t capacity)
+#define FH_MIN_CAPACITY 16
+
+hash_key_t fh_make_key(const char *name)
+{
+    hash_key_t key = 0;
+    for (int i = 0; i < KEY_MAX_SIZE && name[i] != '\0'; i++)
+    {
+        char c = name[i];
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        key |= (hash_key_t)(uint8_t)c << (i * 8);
+    }
+
+    return key;
+}
+
+static inline uint32_t fh_hash_function(hash_key_t key, uint32_t capacity)
+{
+    // Hash de Fibonacci: os bits altos do produto são bem distribuídos, e a máscara substitui o %
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+static uint32_t fh_round_capacity(uint32_t capacity)
 {
-    unsigned int hash = 5381;
-    for (int i = 0; i < KEY_MAX_SIZE && key[i] != '\0'; i++)
-        hash = ((hash << 5) + hash) + key[i];  // hash * 33 + key[i]
+    uint32_t result = FH_MIN_CAPACITY;
+    while (result < capacity && result < (1u << 31))
+        result <<= 1;
 
-    return hash % capacity;
+    return result;
 }
 
 file_hash_t fh_create_hash(uint32_t capacity)
 {
-    file_hash_t file_hash = { .buckets = NULL, .capacity = capacity, .size = 0 };
+    file_hash_t file_hash = { .buckets = NULL, .capacity = fh_round_capacity(capacity), .size = 0 };
 
-    file_hash.buckets = (bucket_t*)malloc(capacity * sizeof(bucket_t));
+    file_hash.buckets = (bucket_t*)calloc(file_hash.capacity, sizeof(bucket_t));
 
-    if (file_hash.buckets != NULL)
-        memset(file_hash.buckets, 0, capacity * sizeof(bucket_t));
+    if (file_hash.buckets == NULL)
+        file_hash.capacity = 0;
 
     return file_hash;
 }
 
-void fh_insert_hash(file_hash_t *file_hash, const char *key, uint32_t value)
+static bool fh_grow(file_hash_t *file_hash)
 {
-    if (file_hash->size >= file_hash->capacity) return;
+    file_hash_t grown = fh_create_hash(file_hash->capacity * 2);
+    if (grown.buckets == NULL) return false;
 
-    uint32_t index = fh_hash_function(key, file_hash->capacity);
-    
     for (uint32_t i = 0; i < file_hash->capacity; i++)
+        if (file_hash->buckets[i].key != 0)
+            fh_insert_key(&grown, file_hash->buckets[i].key, file_hash->buckets[i].value);
+
+    fh_delete_hash(file_hash);
+    *file_hash = grown;
+
+    return true;
+}
+
+bool fh_insert_key(file_hash_t *file_hash, hash_key_t key, uint32_t value)
+{
+    if (key == 0) return false;
+
+    // Mantém a carga abaixo de 3/4 para que as sequências de sondagem fiquem curtas
+    if (file_hash->buckets == NULL || (file_hash->size + 1) * 4 > file_hash->capacity * 3)
     {
-        uint32_t id = (index + i) % file_hash->capacity;
-        if (!file_hash->buckets[id].has_value)
+        if (file_hash->buckets == NULL)
+            *file_hash = fh_create_hash(FH_MIN_CAPACITY);
+        else if (!fh_grow(file_hash))
+            return false;
+
+        if (file_hash->buckets == NULL) return false;
+    }
+
+    uint32_t mask = file_hash->capacity - 1;
+    for (uint32_t id = fh_hash_function(key, file_hash->capacity);; id = (id + 1) & mask)
+    {
+        bucket_t *bucket = &file_hash->buckets[id];
+        if (bucket->key == key)
         {
-            file_hash->buckets[id].has_value = true;
-            file_hash->buckets[id].value = value;
-            memcpy(file_hash->buckets[id].key, key, KEY_MAX_SIZE);
+            bucket->value = value;
+            return true;
+        }
+        else if (bucket->key == 0)
+        {
+            bucket->key = key;
+            bucket->value = value;
             file_hash->size++;
-            return;
+            return true;
         }
     }
 }
 
-bool fh_get_value(file_hash_t *file_hash, const char *key, uint32_t *value)
+bool fh_get_value_by_key(const file_hash_t *file_hash, hash_key_t key, uint32_t *value)
 {
-    uint32_t index = fh_hash_function(key, file_hash->capacity);
-    
-    for (uint32_t i = 0; i < file_hash->capacity; i++)
+    if (file_hash->buckets == NULL || key == 0) return false;
+
+    uint32_t mask = file_hash->capacity - 1;
+    for (uint32_t id = fh_hash_function(key, file_hash->capacity);; id = (id + 1) & mask)
     {
-        uint32_t id = (index + i) % file_hash->capacity;
-        if (!file_hash->buckets[id].has_value) break;
-        else if (strncmp(key, file_hash->buckets[id].key, 8) == 0)
+        const bucket_t *bucket = &file_hash->buckets[id];
+        if (bucket->key == key)
         {
             if (value != NULL)
-                *value = file_hash->buckets[id].value;
+                *value = bucket->value;
             return true;
         }
+        else if (bucket->key == 0)
+            return false;
     }
+}
+
+bool fh_insert_hash(file_hash_t *file_hash, const char *key, uint32_t value)
+{
+    return fh_insert_key(file_hash, fh_make_key(key), value);
+}
 
-    return false;
+bool fh_get_value(const file_hash_t *file_hash, const char *key, uint32_t *value)
+{
+    return fh_get_value_by_key(file_hash, fh_make_key(key), value);
 }
 
 void fh_delete_hash(file_hash_t *file_hash)
 {
     if (file_hash->buckets != NULL)
         free(file_hash->buckets);
+
+    file_hash->buckets = NULL;
+    file_hash->capacity = file_hash->size = 0;
 }
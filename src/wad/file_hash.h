@@ -5,22 +5,30 @@
 
 #define KEY_MAX_SIZE 8
 
+// Nomes de até 8 caracteres empacotados (em maiúsculas) em um inteiro. A chave 0 marca bucket vazio
+typedef uint64_t hash_key_t;
+
 typedef struct _bucket
 {
+    hash_key_t key;
     uint32_t value;
-    char key[KEY_MAX_SIZE];
-    bool has_value;
 } bucket_t;
 
+// Endereçamento aberto com sondagem linear e capacidade potência de 2.
+// Inserir uma chave já existente substitui o valor (o último lump vence, como em PWADs)
 typedef struct _file_hash
 {
     bucket_t *buckets;
     uint32_t capacity, size;
 } file_hash_t;
 
+hash_key_t fh_make_key(const char *name);
+
 file_hash_t fh_create_hash(uint32_t capacity);
-void fh_insert_hash(file_hash_t *file_hash, const char *key, uint32_t value);
-bool fh_get_value(file_hash_t *file_hash, const char *key, uint32_t *value);
+bool fh_insert_key(file_hash_t *file_hash, hash_key_t key, uint32_t value);
+bool fh_get_value_by_key(const file_hash_t *file_hash, hash_key_t key, uint32_t *value);
+bool fh_insert_hash(file_hash_t *file_hash, const char *key, uint32_t value);
+bool fh_get_value(const file_hash_t *file_hash, const char *key, uint32_t *value);
 void fh_delete_hash(file_hash_t *file_hash);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,104 @@
+#include "file_map.h"
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define FM_HAS_MMAP
+#endif
+
+#ifdef FM_HAS_MMAP
+static bool fm_map_file(file_map_t *file_map, const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return false;
+
+    file_map->data = (uint8_t*)data;
+    file_map->size = st.st_size;
+    file_map->mtime = st.st_mtime;
+    file_map->is_mapped = true;
+    return true;
+}
+#endif
+
+// Fallback para plataformas sem mmap: uma única leitura do arquivo inteiro
+static bool fm_read_file(file_map_t *file_map, const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size > 0)
+    {
+        file_map->data = (uint8_t*)malloc(size);
+
+        if (file_map->data != NULL)
+        {
+            if (fread(file_map->data, size, 1, file) == 1)
+            {
+                file_map->size = size;
+                file_map->is_mapped = false;
+                fclose(file);
+                return true;
+            }
+
+            free(file_map->data);
+            file_map->data = NULL;
+        }
+    }
+
+    fclose(file);
+    return false;
+}
+
+file_map_t fm_open(const char *filename)
+{
+    file_map_t file_map = { .data = NULL, .size = 0, .mtime = 0, .is_mapped = false };
+
+#ifdef FM_HAS_MMAP
+    if (fm_map_file(&file_map, filename))
+        return file_map;
+#endif
+
+    if (fm_read_file(&file_map, filename))
+    {
+#ifdef FM_HAS_MMAP
+        struct stat st;
+        if (stat(filename, &st) == 0)
+            file_map.mtime = st.st_mtime;
+#endif
+    }
+    return file_map;
+}
+
+void fm_close(file_map_t *file_map)
+{
+    if (file_map->data == NULL) return;
+
+#ifdef FM_HAS_MMAP
+    if (file_map->is_mapped)
+        munmap(file_map->data, file_map->size);
+    else
+#endif
+        free(file_map->data);
+
+    file_map->data = NULL;
+    file_map->size = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FILE_MAP_H_INCLUDED
+#define FILE_MAP_H_INCLUDED
+
+#include "typedefs.h"
+
+// Arquivo inteiro em memória: mapeado com mmap quando possível,
+// senão lido de uma vez para um buffer
+typedef struct _file_map
+{
+    uint8_t *data;
+    size_t size;
+    int64_t mtime; // Data de modificação, 0 quando não se sabe
+    bool is_mapped;
+} file_map_t;
+
+file_map_t fm_open(const char *filename);
+void fm_close(file_map_t *file_map);
+
+#endif
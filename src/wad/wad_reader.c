@@ -1,58 +1,116 @@
 #include "wad_reader.h"
 #include <stddef.h>
+#include <string.h>
+
+#define WDR_HEADER_SIZE 12
+#define WDR_DIRECTORY_SIZE 16
 
 wad_reader_t wdr_open(const char* filename)
 {
     wad_reader_t wad_reader = {0};
 
-    wad_reader.file = fopen(filename, "rb");
+    wad_reader.file = fm_open(filename);
 
-    if (wad_reader.file != NULL)
+    if (wad_reader.file.data == NULL || wad_reader.file.size < WDR_HEADER_SIZE)
     {
-        fread(&wad_reader.type, sizeof(wad_reader.type), 1, wad_reader.file);
-        fread(&wad_reader.lump_count, sizeof(uint32_t), 1, wad_reader.file);
-        fread(&wad_reader.init_offset, sizeof(uint32_t), 1, wad_reader.file);
+        fm_close(&wad_reader.file);
+        return wad_reader;
+    }
 
-        wad_reader.directories = (directory_t*)malloc(sizeof(directory_t) * wad_reader.lump_count);
+    const uint8_t *data = wad_reader.file.data;
+    memcpy(&wad_reader.type, data, sizeof(wad_reader.type));
+    memcpy(&wad_reader.lump_count, data + 4, sizeof(uint32_t));
+    memcpy(&wad_reader.init_offset, data + 8, sizeof(uint32_t));
 
-        if (wad_reader.directories != NULL)
-        {
-            wad_reader.file_hash = fh_create_hash(wad_reader.lump_count * 2);
-            uint32_t dir_size = sizeof(directory_t);
-            for (uint32_t i = 0; i < wad_reader.lump_count; i++)
-            {
-                uint32_t offset = wad_reader.init_offset + i * dir_size;
+    uint64_t directory_end = (uint64_t)wad_reader.init_offset + (uint64_t)wad_reader.lump_count * WDR_DIRECTORY_SIZE;
+    if (directory_end > wad_reader.file.size)
+    {
+        fm_close(&wad_reader.file);
+        wad_reader.lump_count = 0;
+        return wad_reader;
+    }
 
-                fseek(wad_reader.file, offset, SEEK_SET);
-                fread(&wad_reader.directories[i].filepos, sizeof(uint32_t), 1, wad_reader.file);
-                fread(&wad_reader.directories[i].size, sizeof(uint32_t), 1, wad_reader.file);
-                fread(wad_reader.directories[i].name, sizeof(wad_reader.directories[i].name), 1, wad_reader.file);
-                fh_insert_hash(&wad_reader.file_hash, wad_reader.directories[i].name, i);
-            }
-        }
-        else
+    wad_reader.directories = (directory_t*)malloc(sizeof(directory_t) * wad_reader.lump_count);
+
+    if (wad_reader.directories != NULL)
+    {
+        // O layout de directory_t é o mesmo do arquivo, então o diretório inteiro é copiado de uma vez
+        memcpy(wad_reader.directories, data + wad_reader.init_offset, (size_t)wad_reader.lump_count * WDR_DIRECTORY_SIZE);
+
+        // Um índice incompleto faria os lumps sumirem depois, então sem memória para ele o WAD não abre.
+        // Lumps sem nome não podem ser procurados e ficam de fora
+        bool indexed = true;
+        wad_reader.file_hash = fh_create_hash(wad_reader.lump_count * 2);
+        for (uint32_t i = 0; i < wad_reader.lump_count && indexed; i++)
+            if (wad_reader.directories[i].name[0] != '\0')
+                indexed = fh_insert_hash(&wad_reader.file_hash, wad_reader.directories[i].name, i);
+
+        if (!indexed)
         {
-            fclose(wad_reader.file);
-            wad_reader.file = NULL;
+            fh_delete_hash(&wad_reader.file_hash);
+            free(wad_reader.directories);
+            wad_reader.directories = NULL;
         }
     }
 
+    if (wad_reader.directories == NULL)
+    {
+        fm_close(&wad_reader.file);
+        wad_reader.lump_count = 0;
+    }
+
     return wad_reader;
 }
 
-void *wdr_get_lump_data(const wad_reader_t *wad_reader, uint32_t lump_index, uint32_t header_len, uint32_t *size)
+lump_view_t wdr_get_lump_view(const wad_reader_t *wad_reader, uint32_t lump_index, uint32_t header_len)
 {
+    lump_view_t view = { .data = NULL, .size = 0 };
+
+    if (wad_reader->file.data == NULL || lump_index >= wad_reader->lump_count)
+        return view;
+
     directory_t *lump = &wad_reader->directories[lump_index];
-    void *buffer = malloc(lump->size - header_len);
+    if (header_len > lump->size || (uint64_t)lump->filepos + lump->size > wad_reader->file.size)
+        return view;
+
+    view.data = wad_reader->file.data + lump->filepos + header_len;
+    view.size = lump->size - header_len;
+    return view;
+}
+
+static uint64_t wdr_fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+uint64_t wdr_get_fingerprint(const wad_reader_t *wad_reader)
+{
+    if (wad_reader->file.data == NULL)
+        return 0;
+
+    // O diretório muda com qualquer lump que mude de tamanho ou lugar; edições do mesmo tamanho
+    // ficam por conta da data de modificação
+    uint64_t hash = wdr_fnv1a(14695981039346656037ULL, wad_reader->file.data, WDR_HEADER_SIZE);
+    hash = wdr_fnv1a(hash, wad_reader->file.data + wad_reader->init_offset, (size_t)wad_reader->lump_count * WDR_DIRECTORY_SIZE);
+    hash = wdr_fnv1a(hash, &wad_reader->file.size, sizeof(wad_reader->file.size));
+    return wdr_fnv1a(hash, &wad_reader->file.mtime, sizeof(wad_reader->file.mtime));
+}
+
+void *wdr_get_lump_data(const wad_reader_t *wad_reader, uint32_t lump_index, uint32_t header_len, uint32_t *size)
+{
+    lump_view_t view = wdr_get_lump_view(wad_reader, lump_index, header_len);
+    if (view.data == NULL) return NULL;
+
+    void *buffer = malloc(view.size);
 
     if (buffer != NULL)
     {
-        uint32_t offset = lump->filepos + header_len;
-
-        fseek(wad_reader->file, offset, SEEK_SET);
-        fread(buffer, (lump->size - header_len), 1, wad_reader->file);
+        memcpy(buffer, view.data, view.size);
         if (size != NULL)
-            *size = (lump->size - header_len);
+            *size = view.size;
     }
 
     return buffer;
@@ -60,31 +118,52 @@ void *wdr_get_lump_data(const wad_reader_t *wad_reader, uint32_t lump_index, uin
 
 void wdr_get_lump_header(const wad_reader_t *wad_reader, void *dst, uint32_t lump_index, uint32_t header_len)
 {
-    directory_t *lump = &wad_reader->directories[lump_index];
+    lump_view_t view = wdr_get_lump_view(wad_reader, lump_index, 0);
 
-    fseek(wad_reader->file, lump->filepos, SEEK_SET);
-    fread(dst, header_len, 1, wad_reader->file);
+    if (view.data != NULL && header_len <= view.size)
+        memcpy(dst, view.data, header_len);
+    else
+        memset(dst, 0, header_len);
 }
 
 texture_map_t *wdr_get_texture_map(const wad_reader_t *wad_reader, const texture_header_t *header, uint32_t lump_index)
 {
-    uint32_t texture_map_offset = wad_reader->directories[lump_index].filepos;
-    texture_map_t *texture_maps = (texture_map_t *)malloc(header->texture_count * sizeof(texture_map_t));
+    lump_view_t view = wdr_get_lump_view(wad_reader, lump_index, 0);
+    if (view.data == NULL) return NULL;
+
+    const uint8_t *lump = (const uint8_t*)view.data;
+    texture_map_t *texture_maps = (texture_map_t *)calloc(header->texture_count, sizeof(texture_map_t));
 
     if (texture_maps != NULL)
     {
+        // name(8) + flags(4) + width(2) + height(2) + column_dir(4) + patch_count(2)
+        const uint32_t map_header_len = 22;
+
         for (uint32_t i = 0; i < header->texture_count; i++)
         {
-            uint32_t offset = texture_map_offset + header->texture_data_offset[i];
-            fseek(wad_reader->file, offset, SEEK_SET);
-            fread(&texture_maps[i].name, sizeof(texture_maps[0].name), 1, wad_reader->file);
-            fread(&texture_maps[i].flags, sizeof(texture_maps[0].flags), 1, wad_reader->file);
-            fread(&texture_maps[i].width, sizeof(texture_maps[0].width), 1, wad_reader->file);
-            fread(&texture_maps[i].height, sizeof(texture_maps[0].height), 1, wad_reader->file);
-            fread(&texture_maps[i].column_dir, sizeof(texture_maps[0].column_dir), 1, wad_reader->file);
-            fread(&texture_maps[i].patch_count, sizeof(texture_maps[0].patch_count), 1, wad_reader->file);
-            
-            texture_maps[i].patch_maps = (patch_map_t*)malloc(texture_maps[i].patch_count * sizeof(patch_map_t));
+            uint32_t offset = header->texture_data_offset[i];
+            if ((uint64_t)offset + map_header_len > view.size)
+            {
+                wdr_delete_texture_map(texture_maps, header->texture_count);
+                return NULL;
+            }
+
+            const uint8_t *src = lump + offset;
+            memcpy(&texture_maps[i].name, src, sizeof(texture_maps[0].name));
+            memcpy(&texture_maps[i].flags, src + 8, sizeof(texture_maps[0].flags));
+            memcpy(&texture_maps[i].width, src + 12, sizeof(texture_maps[0].width));
+            memcpy(&texture_maps[i].height, src + 14, sizeof(texture_maps[0].height));
+            memcpy(&texture_maps[i].column_dir, src + 16, sizeof(texture_maps[0].column_dir));
+            memcpy(&texture_maps[i].patch_count, src + 20, sizeof(texture_maps[0].patch_count));
+
+            uint32_t patch_maps_size = texture_maps[i].patch_count * sizeof(patch_map_t);
+            if ((uint64_t)offset + map_header_len + patch_maps_size > view.size)
+            {
+                wdr_delete_texture_map(texture_maps, header->texture_count);
+                return NULL;
+            }
+
+            texture_maps[i].patch_maps = (patch_map_t*)malloc(patch_maps_size);
             
             if (texture_maps[i].patch_maps == NULL)
             {
@@ -92,7 +171,7 @@ texture_map_t *wdr_get_texture_map(const wad_reader_t *wad_reader, const texture
                 return NULL;
             }
 
-            fread(texture_maps[i].patch_maps, sizeof(patch_map_t), texture_maps[i].patch_count, wad_reader->file);
+            memcpy(texture_maps[i].patch_maps, src + map_header_len, patch_maps_size);
         }
     }
 
@@ -107,90 +186,52 @@ void wdr_delete_texture_map(texture_map_t *texture_maps, uint32_t size)
     free(texture_maps);
 }
 
-patch_colum_t *wdr_get_patch_columns(const wad_reader_t *wad_reader, const patch_header_t *header, uint32_t lump_index, uint32_t *size_out)
+bool wdr_get_patch_header(const wad_reader_t *wad_reader, patch_header_t *header, uint32_t lump_index)
 {
-    uint32_t patch_offset = wad_reader->directories[lump_index].filepos;
-    uint32_t capacity = 2;
-    uint32_t size = 0;
-    patch_colum_t *patch_columns = (patch_colum_t *)malloc(capacity * sizeof(patch_colum_t));
+    // width(2) + height(2) + left_offset(2) + top_offset(2), seguido de width offsets de coluna
+    const uint32_t header_len = sizeof(*header) - sizeof(header->column_offset);
+    lump_view_t view = wdr_get_lump_view(wad_reader, lump_index, 0);
 
-    for (uint32_t i = 0; i < header->width; i++)
-    {
-        uint32_t offset = patch_offset + header->column_offset[i];
-        while (true)
-        {
-            if (size >= capacity)
-            {
-                capacity *= 2;
-                patch_colum_t *tmp = (patch_colum_t *)realloc(patch_columns, capacity * sizeof(patch_colum_t));
+    if (view.data == NULL || view.size < header_len) return false;
 
-                if (tmp == NULL)
-                {
-                    wdr_delete_patch_columns(patch_columns, size);
-                    return NULL;
-                }
+    memcpy(header, view.data, header_len);
+    header->column_offset = (uint32_t*)((const uint8_t*)view.data + header_len);
 
-                patch_columns = tmp;
-            }
+    return header->width <= (view.size - header_len) / sizeof(uint32_t);
+}
 
-            patch_colum_t *column = &patch_columns[size];
-            fseek(wad_reader->file, offset, SEEK_SET);
-            fread(&column->top_delta, sizeof(uint8_t), 1, wad_reader->file);
-    
-            if (column->top_delta != 0xFF)
-            {
-                // Lendo o length e o padding pre de uma vez só
-                fread(&column->length, sizeof(uint8_t), 2, wad_reader->file);
+bool wdr_for_each_patch_post(const wad_reader_t *wad_reader, const patch_header_t *header, uint32_t lump_index, patch_post_func_t post_func, void *ctx)
+{
+    lump_view_t view = wdr_get_lump_view(wad_reader, lump_index, 0);
+    if (view.data == NULL) return false;
 
-                column->data = (uint8_t*)malloc(column->length);
+    const uint8_t *lump = (const uint8_t*)view.data;
 
-                if (column->data == NULL)
-                {
-                    wdr_delete_patch_columns(patch_columns, size);
-                    return NULL;
-                }
+    for (uint16_t x = 0; x < header->width; x++)
+    {
+        uint32_t offset = header->column_offset[x];
+        while (true)
+        {
+            if (offset >= view.size) return false;
 
-                fread(column->data, sizeof(uint8_t), column->length, wad_reader->file);
-                fread(&column->padding_post, sizeof(uint8_t), 1, wad_reader->file);
-                offset += 4 + column->length;
-                size++;
-            }
-            else
-            {
-                column->data = NULL;
-                offset++;
-                size++;
-                break;
-            }
-        }
-    }
+            uint8_t top_delta = lump[offset];
+            if (top_delta == 0xFF) break;
 
-    patch_colum_t *tmp = realloc(patch_columns, size * sizeof(patch_colum_t));
-    if (tmp == NULL)
-    {
-        wdr_delete_patch_columns(patch_columns, size);
-        patch_columns = NULL;
-        size = 0;
-    }
-    else
-        patch_columns = tmp;
+            // top_delta + length + padding_pre + dados + padding_post
+            if (offset + 3 > view.size || offset + 4 + lump[offset + 1] > view.size) return false;
 
-    *size_out = size;
-    return patch_columns;
-}
+            uint8_t length = lump[offset + 1];
+            post_func(ctx, x, top_delta, lump + offset + 3, length);
+            offset += 4 + length;
+        }
+    }
 
-void wdr_delete_patch_columns(patch_colum_t *patch_columns, uint32_t size)
-{
-    for (uint32_t i = 0; i < size; i++)
-        if (patch_columns[i].data != NULL)
-            free(patch_columns[i].data);
-    free(patch_columns);
+    return true;
 }
 
 void wdr_close(wad_reader_t *wad_reader)
 {
-    if (wad_reader->file != NULL)
-        fclose(wad_reader->file);
+    fm_close(&wad_reader->file);
 
     if (wad_reader->directories != NULL)
         free(wad_reader->directories);
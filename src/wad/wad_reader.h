@@ -3,6 +3,7 @@
 
 #include "typedefs.h"
 #include "file_hash.h"
+#include "file_map.h"
 #include <stdio.h>
 
 typedef enum _lump_indices
@@ -26,22 +27,35 @@ typedef struct _directory
     char name[8];
 } directory_t;
 
+// Visão de um lump dentro do arquivo mapeado (não é uma cópia)
+typedef struct _lump_view
+{
+    const void *data;
+    uint32_t size;
+} lump_view_t;
+
+// Chamada para cada post de um patch; data aponta direto para o lump mapeado
+typedef void (*patch_post_func_t)(void *ctx, uint16_t x, uint8_t top_delta, const uint8_t *data, uint8_t length);
+
 typedef struct _wad_reader
 {
     char type[4];
     uint32_t lump_count, init_offset;
     directory_t *directories;
     file_hash_t file_hash;
-    FILE *file;
+    file_map_t file;
 } wad_reader_t;
 
 wad_reader_t wdr_open(const char* filename);
+lump_view_t wdr_get_lump_view(const wad_reader_t *wad_reader, uint32_t lump_index, uint32_t header_len);
+// Identifica o WAD sem ler os lumps: FNV-1a do cabeçalho e do diretório, com o tamanho e a data do arquivo
+uint64_t wdr_get_fingerprint(const wad_reader_t *wad_reader);
 void* wdr_get_lump_data(const wad_reader_t *wad_reader, uint32_t lump_index, uint32_t header_len, uint32_t *size);
 void wdr_get_lump_header(const wad_reader_t *wad_reader, void *dst, uint32_t lump_index, uint32_t header_len);
 texture_map_t *wdr_get_texture_map(const wad_reader_t *wad_reader, const texture_header_t *header, uint32_t lump_index);
 void wdr_delete_texture_map(texture_map_t *texture_maps, uint32_t size);
-patch_colum_t *wdr_get_patch_columns(const wad_reader_t *wad_reader, const patch_header_t *header, uint32_t lump_index, uint32_t *size_out);
-void wdr_delete_patch_columns(patch_colum_t *patch_columns, uint32_t size);
+bool wdr_get_patch_header(const wad_reader_t *wad_reader, patch_header_t *header, uint32_t lump_index);
+bool wdr_for_each_patch_post(const wad_reader_t *wad_reader, const patch_header_t *header, uint32_t lump_index, patch_post_func_t post_func, void *ctx);
 void wdr_close(wad_reader_t *wad_reader);
 
-#endif
\ No newline at end of file
+#endif
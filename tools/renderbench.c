@@ -0,0 +1,216 @@
+// Benchmark do renderer: desenha o mesmo conjunto de vistas (a câmera girando no spawn do jogador)
+// em várias larguras de tela, para ver como o tempo por frame cresce com a resolução horizontal.
+// Com -fixed a câmera fica parada num ângulo (em graus), bom para comparar mudanças no desenho das colunas.
+// -strips divide a tela em N faixas desenhadas em paralelo (padrão 1, um thread só).
+// -walls escolhe o caminho das paredes: fixed (padrão, ponto fixo) ou float.
+// -ppm grava o último frame de cada largura em <prefixo>_<largura>.ppm.
+// O renderer roda sem janela, então o benchmark não precisa de X nem Wayland.
+//
+// Uso: bin/renderbench [wad] [-map ExMy] [-widths 320,640,...] [-height N] [-angles N] [-passes N] [-fixed graus] [-strips N] [-walls fixed|float] [-ppm prefixo]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "renderer/renderer.h"
+#include "bsp/bsp.h"
+#include "assets/asset.h"
+#include "core/jobs.h"
+#include "core/timer.h"
+
+#define MAX_WIDTHS 16
+#define EYE_HEIGHT 43
+
+typedef struct _width_stats
+{
+    uint16_t width;
+    double bsp_mean, bsp_median, frame_mean, frame_median;
+} width_stats_t;
+
+static int rb_compare_ms(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double rb_median(double *samples, uint32_t count)
+{
+    qsort(samples, count, sizeof(double), rb_compare_ms);
+    return (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) * 0.5;
+}
+
+static uint32_t rb_parse_widths(char *list, uint16_t *widths)
+{
+    uint32_t count = 0;
+    for (char *token = strtok(list, ","); token != NULL && count < MAX_WIDTHS; token = strtok(NULL, ","))
+    {
+        int width = atoi(token);
+        if (width > 0 && width <= INT16_MAX / 2)
+            widths[count++] = (uint16_t)width;
+    }
+
+    return count;
+}
+
+static bool rb_run_width(bsp_t *bsp, uint16_t width, uint16_t height, uint32_t angles, uint32_t passes, float fixed_angle, uint16_t strips, bool fixed_point_walls, const char *ppm_prefix, width_stats_t *stats)
+{
+    if (!r_init_headless(width, height))
+        return false;
+
+    r_set_fixed_point_walls(fixed_point_walls);
+
+    if (!r_set_strip_count(strips))
+    {
+        r_shutdown();
+        return false;
+    }
+
+    uint32_t frame_count = angles * passes;
+    double *bsp_ms = malloc(frame_count * sizeof(double));
+    double *frame_ms = malloc(frame_count * sizeof(double));
+    if (bsp_ms == NULL || frame_ms == NULL)
+    {
+        free(bsp_ms);
+        free(frame_ms);
+        r_shutdown();
+        return false;
+    }
+
+    vec3f_t spawn = bsp_get_player_spawn(bsp);
+    player_t player = {0};
+    player.position = (vec3f_t) { spawn.x, spawn.y, spawn.z + EYE_HEIGHT };
+    if (fixed_angle >= 0)
+        player.angle = fixed_angle;
+
+    // Um frame de aquecimento para a arena do frame e as texturas chegarem ao tamanho final
+    r_begin_draw(&player);
+    bsp_update(bsp, player.position, player.angle);
+    bsp_render(bsp);
+    r_end_draw();
+
+    double bsp_total = 0, frame_total = 0;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        if (fixed_angle < 0)
+            player.angle = (i % angles) * (2 * PI / angles);
+
+        uint64_t frame_start = t_get_counter();
+        r_begin_draw(&player);
+        bsp_update(bsp, player.position, player.angle);
+
+        uint64_t bsp_start = t_get_counter();
+        bsp_render(bsp);
+        bsp_ms[i] = t_get_elapsed_ms(bsp_start);
+
+        r_end_draw();
+        frame_ms[i] = t_get_elapsed_ms(frame_start);
+
+        bsp_total += bsp_ms[i];
+        frame_total += frame_ms[i];
+    }
+
+    if (ppm_prefix != NULL)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s_%u.ppm", ppm_prefix, width);
+        r_write_ppm(path);
+    }
+
+    stats->width = width;
+    stats->bsp_mean = bsp_total / frame_count;
+    stats->frame_mean = frame_total / frame_count;
+    stats->bsp_median = rb_median(bsp_ms, frame_count);
+    stats->frame_median = rb_median(frame_ms, frame_count);
+
+    free(bsp_ms);
+    free(frame_ms);
+    r_shutdown();
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *wad_path = "resources/DOOM1.WAD";
+    const char *level_name = "E1M1";
+    char default_widths[] = "160,320,640,960,1280,1920";
+    char *width_list = default_widths;
+    uint16_t height = 200;
+    uint32_t angles = 64, passes = 4;
+    float fixed_angle = -1;
+    uint16_t strips = 1;
+    const char *walls = "fixed";
+    const char *ppm_prefix = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) level_name = argv[++i];
+        else if (strcmp(argv[i], "-widths") == 0 && i + 1 < argc) width_list = argv[++i];
+        else if (strcmp(argv[i], "-height") == 0 && i + 1 < argc) height = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-angles") == 0 && i + 1 < argc) angles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-passes") == 0 && i + 1 < argc) passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-strips") == 0 && i + 1 < argc) strips = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-walls") == 0 && i + 1 < argc) walls = argv[++i];
+        else if (strcmp(argv[i], "-ppm") == 0 && i + 1 < argc) ppm_prefix = argv[++i];
+        else if (strcmp(argv[i], "-fixed") == 0 && i + 1 < argc) fixed_angle = fmodf(fmodf(atof(argv[++i]), 360.f) + 360.f, 360.f) * PI / 180.f;
+        else if (argv[i][0] != '-') wad_path = argv[i];
+        else
+        {
+            fprintf(stderr, "Uso: %s [wad] [-map ExMy] [-widths 320,640,...] [-height N] [-angles N] [-passes N] [-fixed graus] [-strips N] [-walls fixed|float] [-ppm prefixo]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    uint16_t widths[MAX_WIDTHS];
+    uint32_t width_count = rb_parse_widths(width_list, widths);
+    bool fixed_point_walls = strcmp(walls, "fixed") == 0;
+    if (width_count == 0 || height == 0 || angles == 0 || passes == 0 || strips == 0 || (!fixed_point_walls && strcmp(walls, "float") != 0))
+    {
+        fprintf(stderr, "Parametros invalidos\n");
+        return 1;
+    }
+
+    if (!j_init(0))
+        return 1;
+
+    wad_reader_t wdr = wdr_open(wad_path);
+    if (wdr.directories == NULL)
+    {
+        fprintf(stderr, "Nao foi possivel abrir %s\n", wad_path);
+        return 1;
+    }
+
+    a_init(&wdr, NULL);
+    bsp_t bsp = bsp_create(&wdr, level_name);
+    if (bsp.nodes == NULL)
+    {
+        fprintf(stderr, "Mapa %s nao encontrado\n", level_name);
+        return 1;
+    }
+
+    printf("%u faixa(s), %u thread(s), paredes em %s\n", strips, j_get_thread_count(), fixed_point_walls ? "ponto fixo" : "float");
+    if (fixed_angle >= 0)
+        printf("wad %s, mapa %s, altura %u, camera fixa em %.1f graus, %u frames\n", wad_path, level_name, height, fixed_angle * 180.f / PI, angles * passes);
+    else
+        printf("wad %s, mapa %s, altura %u, %u angulos x %u passadas\n", wad_path, level_name, height, angles, passes);
+    printf("%8s %10s %10s %10s %10s %12s\n", "largura", "bsp_media", "bsp_med", "frame_media", "frame_med", "ns/coluna");
+
+    for (uint32_t i = 0; i < width_count; i++)
+    {
+        width_stats_t stats;
+        if (!rb_run_width(&bsp, widths[i], height, angles, passes, fixed_angle, strips, fixed_point_walls, ppm_prefix, &stats))
+        {
+            fprintf(stderr, "Nao foi possivel iniciar o renderer em %ux%u\n", widths[i], height);
+            continue;
+        }
+
+        printf("%8u %10.3f %10.3f %10.3f %10.3f %12.1f\n", stats.width,
+            stats.bsp_mean, stats.bsp_median, stats.frame_mean, stats.frame_median,
+            stats.bsp_median * 1e6 / stats.width);
+    }
+
+    bsp_delete(&bsp);
+    a_shutdown();
+    wdr_close(&wdr);
+    j_shutdown();
+    return 0;
+}
@@ -0,0 +1,325 @@
+// Benchmark do carregamento do WAD: abre o WAD, roda o pipeline completo de assets e carrega
+// todos os mapas, medindo cada fase com o page cache frio e depois quente.
+//
+// Uso: bin/wadbench [wad] [-threads N] [-passes N] [-cache arquivo] [-budget tamanho]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "wad/wad_reader.h"
+#include "assets/asset.h"
+#include "bsp/bsp.h"
+#include "core/jobs.h"
+#include "core/timer.h"
+#include "utils.h"
+
+#define MAX_LEVELS 128
+
+typedef enum _phase
+{
+    PHASE_OPEN,
+    PHASE_ASSETS,
+    PHASE_MAPS,
+    PHASE_CLOSE,
+    PHASE_COUNT,
+} phase_t;
+
+static const char *phase_names[PHASE_COUNT] = { "open", "assets", "maps", "close" };
+
+typedef struct _io_counters
+{
+    uint64_t read_syscalls, read_chars, disk_bytes;
+    long major_faults, minor_faults;
+} io_counters_t;
+
+typedef struct _phase_stats
+{
+    double ms;
+    io_counters_t io;
+    uint64_t allocs, alloc_bytes;
+    int64_t peak_heap;
+} phase_stats_t;
+
+// Contadores de alocação, alimentados pelos wrappers do linker (-Wl,--wrap=malloc,...)
+static uint64_t alloc_count, alloc_bytes;
+static int64_t live_bytes, peak_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+void __real_free(void *ptr);
+
+static void wb_track_alloc(void *ptr)
+{
+    if (ptr == NULL) return;
+
+    int64_t size = (int64_t)malloc_usable_size(ptr);
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc_bytes, size, __ATOMIC_RELAXED);
+    int64_t live = __atomic_add_fetch(&live_bytes, size, __ATOMIC_RELAXED);
+
+    int64_t peak = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&peak_bytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void wb_track_free(void *ptr)
+{
+    if (ptr != NULL)
+        __atomic_fetch_sub(&live_bytes, (int64_t)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    wb_track_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    wb_track_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    wb_track_free(ptr);
+    void *new_ptr = __real_realloc(ptr, size);
+    // Se o realloc falhar o bloco antigo continua vivo
+    wb_track_alloc(new_ptr != NULL ? new_ptr : ptr);
+    return new_ptr;
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr = __real_aligned_alloc(alignment, size);
+    wb_track_alloc(ptr);
+    return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    wb_track_free(ptr);
+    __real_free(ptr);
+}
+
+// Custo de ler os próprios contadores, descontado de cada fase
+static io_counters_t probe_overhead;
+
+static io_counters_t wb_read_io()
+{
+    io_counters_t io = {0};
+
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file != NULL)
+    {
+        char key[32];
+        unsigned long long value;
+        while (fscanf(file, "%31[^:]: %llu\n", key, &value) == 2)
+        {
+            if (strcmp(key, "syscr") == 0) io.read_syscalls = value;
+            else if (strcmp(key, "rchar") == 0) io.read_chars = value;
+            else if (strcmp(key, "read_bytes") == 0) io.disk_bytes = value;
+        }
+        fclose(file);
+    }
+#endif
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        io.major_faults = usage.ru_majflt;
+        io.minor_faults = usage.ru_minflt;
+    }
+
+    return io;
+}
+
+typedef struct _phase_probe
+{
+    uint64_t start;
+    io_counters_t io;
+    uint64_t allocs, alloc_bytes;
+} phase_probe_t;
+
+static phase_probe_t wb_begin_phase()
+{
+    // O pico é medido por fase, a partir do que já estava vivo
+    __atomic_store_n(&peak_bytes, __atomic_load_n(&live_bytes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+
+    phase_probe_t probe = {
+        .io = wb_read_io(),
+        .allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED),
+        .alloc_bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED),
+    };
+    probe.start = t_get_counter();
+    return probe;
+}
+
+static void wb_end_phase(const phase_probe_t *probe, phase_stats_t *stats)
+{
+    stats->ms = t_get_elapsed_ms(probe->start);
+    io_counters_t io = wb_read_io();
+
+    stats->io = (io_counters_t){
+        .read_syscalls = io.read_syscalls - probe->io.read_syscalls - probe_overhead.read_syscalls,
+        .read_chars = io.read_chars - probe->io.read_chars - probe_overhead.read_chars,
+        .disk_bytes = io.disk_bytes - probe->io.disk_bytes,
+        .major_faults = io.major_faults - probe->io.major_faults,
+        .minor_faults = io.minor_faults - probe->io.minor_faults,
+    };
+    stats->allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED) - probe->allocs;
+    stats->alloc_bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED) - probe->alloc_bytes;
+    stats->peak_heap = __atomic_load_n(&peak_bytes, __ATOMIC_RELAXED);
+}
+
+// Tira o arquivo do page cache (só páginas limpas, não precisa de root)
+static bool wb_drop_page_cache(const char *filename)
+{
+    if (filename == NULL) return true;
+
+    // Um arquivo que ainda não existe (ex: o cache na primeira execução) não tem o que esvaziar
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return true;
+
+    fdatasync(fd);
+    bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+
+    return dropped;
+}
+
+static bool wb_is_level_name(const char *name)
+{
+    // ExMy ou MAPxx
+    if (name[0] == 'E' && name[1] >= '0' && name[1] <= '9' && name[2] == 'M' && name[3] >= '0' && name[3] <= '9' && name[4] == '\0')
+        return true;
+
+    return strncmp(name, "MAP", 3) == 0 && name[3] >= '0' && name[3] <= '9' && name[4] >= '0' && name[4] <= '9' && name[5] == '\0';
+}
+
+static uint32_t wb_run_pass(const char *wad_path, const char *cache_path, phase_stats_t *stats, residency_stats_t *residency)
+{
+    phase_probe_t probe = wb_begin_phase();
+    wad_reader_t wdr = wdr_open(wad_path);
+    wb_end_phase(&probe, &stats[PHASE_OPEN]);
+
+    if (wdr.directories == NULL)
+    {
+        fprintf(stderr, "Nao foi possivel abrir %s\n", wad_path);
+        return 0;
+    }
+
+    probe = wb_begin_phase();
+    a_init(&wdr, cache_path);
+    wb_end_phase(&probe, &stats[PHASE_ASSETS]);
+
+    static bsp_t levels[MAX_LEVELS];
+    uint32_t level_count = 0;
+
+    probe = wb_begin_phase();
+    for (uint32_t i = 0; i < wdr.lump_count && level_count < MAX_LEVELS; i++)
+    {
+        char name[9] = {0};
+        memcpy(name, wdr.directories[i].name, 8);
+
+        if (wb_is_level_name(name))
+            levels[level_count++] = bsp_create(&wdr, name);
+    }
+    wb_end_phase(&probe, &stats[PHASE_MAPS]);
+
+    // Com todos os mapas carregados, antes de soltar as texturas
+    *residency = a_get_residency_stats();
+
+    probe = wb_begin_phase();
+    for (uint32_t i = 0; i < level_count; i++)
+        bsp_delete(&levels[i]);
+    a_shutdown();
+    wdr_close(&wdr);
+    wb_end_phase(&probe, &stats[PHASE_CLOSE]);
+
+    return level_count;
+}
+
+static void wb_print_pass(const char *label, uint32_t level_count, const phase_stats_t *stats, const residency_stats_t *residency)
+{
+    printf("\n%s (%u mapas)\n", label, level_count);
+    printf("%-8s %10s %8s %12s %12s %8s %8s %8s %12s %12s\n",
+        "fase", "ms", "syscr", "rchar", "disco", "majflt", "minflt", "allocs", "alloc_bytes", "pico_heap");
+
+    for (uint32_t i = 0; i < PHASE_COUNT; i++)
+    {
+        const phase_stats_t *s = &stats[i];
+        printf("%-8s %10.3f %8llu %12llu %12llu %8ld %8ld %8llu %12llu %12lld\n",
+            phase_names[i], s->ms,
+            (unsigned long long)s->io.read_syscalls, (unsigned long long)s->io.read_chars, (unsigned long long)s->io.disk_bytes,
+            s->io.major_faults, s->io.minor_faults,
+            (unsigned long long)s->allocs, (unsigned long long)s->alloc_bytes, (long long)s->peak_heap);
+    }
+
+    printf("residentes: %u texturas, %u flats, %zu KB", residency->resident_textures, residency->resident_flats, residency->resident_bytes / 1024);
+    if (residency->budget_bytes > 0)
+        printf(" de %zu KB, %u compostas, %u despejadas", residency->budget_bytes / 1024, residency->composed_count, residency->evicted_count);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *wad_path = "resources/DOOM1.WAD";
+    const char *cache_path = NULL;
+    uint32_t thread_count = 0, passes = 2;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) thread_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-passes") == 0 && i + 1 < argc) passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) cache_path = argv[++i];
+        else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc) a_set_residency_budget(u_parse_size(argv[++i]));
+        else if (argv[i][0] != '-') wad_path = argv[i];
+        else
+        {
+            fprintf(stderr, "Uso: %s [wad] [-threads N] [-passes N] [-cache arquivo] [-budget tamanho]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!j_init(thread_count))
+        return 1;
+
+    phase_stats_t empty;
+    phase_probe_t probe = wb_begin_phase();
+    wb_end_phase(&probe, &empty);
+    probe_overhead = empty.io;
+
+    printf("wad %s, %u threads, cache %s\n", wad_path, j_get_thread_count(), cache_path != NULL ? cache_path : "desligado");
+
+    for (uint32_t pass = 0; pass < passes; pass++)
+    {
+        // A primeira passada começa com o page cache frio, as demais reaproveitam as páginas
+        bool cold = pass == 0;
+        if (cold && (!wb_drop_page_cache(wad_path) || !wb_drop_page_cache(cache_path)))
+            fprintf(stderr, "Aviso: nao foi possivel esvaziar o page cache, a passada fria pode estar quente\n");
+
+        phase_stats_t stats[PHASE_COUNT] = {0};
+        residency_stats_t residency = {0};
+        uint32_t level_count = wb_run_pass(wad_path, cache_path, stats, &residency);
+
+        char label[32];
+        snprintf(label, sizeof(label), "passada %u (%s)", pass + 1, cold ? "fria" : "quente");
+        wb_print_pass(label, level_count, stats, &residency);
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        printf("\npico de RSS: %ld KB\n", usage.ru_maxrss);
+
+    j_shutdown();
+    return 0;
+}